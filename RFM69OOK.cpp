@@ -22,7 +22,7 @@ This library makes reference to RFM69(H)W_OOK_Library_Vx.y.pdf
 *                                                      DESCRIPTION                                                      *
 *                                                                                                                       *
 /************************************************************************************************************************
-* Version:      1.4
+* Version:      1.23
 * Date:         15/11/2017
 * Author:       Robert 
 * Description:  Library for OOK Kaku alike transmission using RFM69 transceivers
@@ -39,8 +39,8 @@ This library makes reference to RFM69(H)W_OOK_Library_Vx.y.pdf
 * Software:     Tested with RFM69 Library version 9 May 2015 (see https://github.com/LowPowerLab/RFM69)
 * Documentation:
 				RFM69(H)W_OOK_Library_Vx.y.pdf (see https://github.com/rrobinet/RFM69OOK )
-* Notes:        1. 	This library is currently limited to OOK TRANSMISSION using a RFM69(H)W transceivers
-*					(RFM69(H)CW and OOK RECEPTION are not scoped)
+* Notes:        1. 	This library is mainly intended to OOK TRANSMISSION using a RFM69(H)W transceivers
+*					(RFM69(H)CW is not scoped); OOK RECEPTION of the KAKU protocols is offered by RFM69OOKReceiver
 *				2.	Functions are limited to a set of well known OOK protocols aka KAKU protocols
 *					(Klik aan Klik uit) more specifically to KAKU OLD, KAKU NEW and KAKU GOGEX
 *					(see https://github.com/rrobinet/SAW_Devices_and_OOK/blob/master/OOK_Protocols_decription_V0.0.pdf)
@@ -92,8 +92,73 @@ This library makes reference to RFM69(H)W_OOK_Library_Vx.y.pdf
 *	    value calcutation crash with the ESP8266
 * 1.3 - Save and restore of Bit rate MSB and LSB register while calling a OOK function 
 * 1.4 - Add pre and post sending procedure for OOK frame sending
+* 1.5 - Split OOK sending in an encode stage (OokFrame) and an emit stage replaying the frame for each repeat
+* 1.6 - Add non-blocking timer-interrupt driven sending (beginSend..., isBusy, onSendDone) with OokTimer backends
+* 1.7 - Add a command queue sent in one batch sharing a single pre and post sending procedure (flush)
+* 1.8 - Add an optional shadow cache of the RFM69 registers used by the pre and post sending procedures
+* 1.9 - Edges are output against absolute deadlines, the processing delay is measured by calibrate()
+* 1.10 - Add RFM69OOKFast<PIN> with the OOK data pin port register and bit mask resolved at compile time
+* 1.11 - Add the FIFO transmit backend: frames are sent by the RFM69 packet engine, no DIO2 connection is needed
+* 1.12 - Table-driven encoder using OokProtocol descriptors, add PT2262, EV1527 and HomeEasy descriptors
+* 1.13 - Add airtime() and dryRun() edge error measurement of encoded frames
+* 1.14 - Add RFM69OOKReceiver: interrupt-driven OOK reception with a streaming KAKU New, Old and Cogex decoder
+* 1.15 - Add transmit telemetry (getStats): frames, repeats, TX on time, CSMA waits, register accesses, edge lateness
+* 1.16 - Add RFM69OOKMulti: frames of several RFM69 sent at the same time from one merged edge schedule
+* 1.17 - Add RFM69OOKScene: scene compiler using New group commands and a device state cache to skip redundant sends
+* 1.18 - Add non-blocking channel access (channelAccess): RSSI threshold, random backoff, force/drop/defer policy
+* 1.19 - Add raw captures: quantized pulse symbol table and packed indices replayed from program memory
+* 1.20 - Replace the Serial debug output (printOokInfos) by a binary trace ring printed later by dumpTrace
+* 1.21 - Add FSK coexistence: FSK packets are received between OOK repeats with a bounded blind window
+* 1.22 - Add RFM69OOKService: one worker owning the radio, fed by a lock-free MPSC queue per priority (ESP32, Linux)
+* 1.23 - Add the low power mode (RFM69 standby and MCU sleep between repeats) and the per sending charge estimation
 ************************************************************************************************************************/
 #include "RFM69OOK.h"
+
+// Asynchronous sending states
+#define OOK_TX_IDLE		0
+#define OOK_TX_RUNNING	1
+#define OOK_TX_DONE		2
+#define OOK_TX_ACCESS	3
+// Shadow register cache slots
+#define OOK_SLOT_PACKETCONFIG2	0
+#define OOK_SLOT_OPMODE			1
+#define OOK_SLOT_DATAMODUL		2
+#define OOK_SLOT_BITRATEMSB		3
+#define OOK_SLOT_BITRATELSB		4
+#define OOK_SLOT_NONE			0xFF
+
+RFM69OOK *RFM69OOK::_asyncOwner = NULL;
+#if OOK_TRACE_SIZE
+OokTraceEntry RFM69OOK::_trace[OOK_TRACE_SIZE];
+byte RFM69OOK::_traceHead = 0;
+byte RFM69OOK::_traceCount = 0;
+unsigned int RFM69OOK::_traceLost = 0;
+#endif
+// Packet engine registers saved and restored around a FIFO backend sending
+static const byte ookFifoRegs[] = { REG_PREAMBLEMSB, REG_PREAMBLELSB, REG_SYNCCONFIG, REG_PACKETCONFIG1, 
+	REG_PAYLOADLENGTH, REG_FIFOTHRESH, REG_PACKETCONFIG2 };
+#define OOK_FIFO_SAVED_PACKETCONFIG2	6
+static OokFrame ookAsyncFrame;				// Frame encoded by the beginSendKaku... functions (one timer, one sending)
+#if OOK_STATS
+// Upper limits of the CSMA wait histogram buckets (ms), the last bucket takes the longer waits
+static const unsigned int ookCsmaBuckets[OOK_CSMA_BUCKETS - 1] = { 0, 1, 10, 100 };
+#endif
+
+/*************************************************** ookDefaultTimer ***************************************************
+* Function:  	Return the timer backend of the current platform, NULL if none is available
+/***********************************************************************************************************************/
+static OokTimer *ookDefaultTimer()
+{
+#if defined(__AVR__)
+	static OokTimerAvr1 timer;
+	return &timer;
+#elif defined(ESP8266)
+	static OokTimerEsp8266 timer;
+	return &timer;
+#else
+	return NULL;
+#endif
+}
 /****************************************************** RFM69OOK *******************************************************
 * Function:  	Define a RFM69OOK Class with default parameters
 * Parameters:	None
@@ -104,6 +169,45 @@ RFM69OOK::RFM69OOK ()
    	_periodusec=300;				// Processor OOK pulse time for OOK SAW devices is 300 us
    	_repeats=10;					// Number of time the OOK datagram is repeated is by default 10
    	_repDly=20;						// Default delay between datagrams is 20 ms
+   	_timer=NULL;					// Platform timer selected at the first asynchronous sending
+   	_doneCallback=NULL;				// No asynchronous sending done function
+   	_txState=OOK_TX_IDLE;			// No asynchronous sending in progress
+   	_queueLength=0;					// Empty command queue
+   	_regReads=0;					// No register access yet
+   	_regWrites=0;
+   	_regCacheOn=false;				// Register shadow cache disabled
+   	_regValid=0;
+   	_edgeLead=OOK_EDGE_LEAD;		// Default processing delay until calibrate() is called
+   	_txBackend=OOK_BACKEND_DIO2;	// Frames are output on the DIO2 pin
+   	_fifoActive=false;
+   	_rssiThreshold=0;				// Clear channel tested by the RFM69 library
+   	_accessLimitMs=RF69_CSMA_LIMIT_MS;
+   	_accessPolicy=OOK_CSMA_FORCE;	// Send anyway when the channel stays busy
+   	_backoffMin=OOK_BACKOFF_MIN;
+   	_backoffMax=OOK_BACKOFF_MAX;
+   	_accessState=OOK_CHANNEL_READY;	// No channel access in progress
+   	_channelGranted=false;
+   	_coexBlindMs=0;					// No FSK reception during OOK sendings
+   	_coexListenMs=OOK_FSK_LISTEN_MS;
+   	_fskListen=false;
+   	_lowPower=false;				// RFM69 left in transmit mode between repeats
+   	_sleep=NULL;
+   	_emitEnd=0;
+   	_traceMuted=false;
+#if OOK_STATS
+   	memset(&_energy, 0, sizeof(_energy));
+   	_emitCarrierUsec=0;
+   	_carrierUa=OOK_CARRIER_UA;
+   	_txIdleUa=OOK_TX_IDLE_UA;
+   	_standbyUa=OOK_STANDBY_UA;
+   	_rxUa=OOK_RX_UA;
+#endif
+#if OOK_FSK_PACKETS
+   	_fskHead=0;						// No FSK packet received
+   	_fskCount=0;
+   	_fskCurrent=0;
+#endif
+   	resetStats();					// No telemetry yet
    	pinMode(_ookDataPin, OUTPUT);	// Set OOK pin to output
    	digitalWrite(_ookDataPin,LOW);	// with default low value
 }
@@ -121,6 +225,45 @@ RFM69OOK::RFM69OOK(byte dataPin, unsigned int periodusec, byte repeats, byte rep
    _periodusec=periodusec;
    _repeats=repeats;
    _repDly = repDly; 
+   _timer=NULL;
+   _doneCallback=NULL;
+   _txState=OOK_TX_IDLE;
+   _queueLength=0;
+   _regReads=0;
+   _regWrites=0;
+   _regCacheOn=false;
+   _regValid=0;
+   _edgeLead=OOK_EDGE_LEAD;
+   _txBackend=OOK_BACKEND_DIO2;
+   _fifoActive=false;
+   _rssiThreshold=0;
+   _accessLimitMs=RF69_CSMA_LIMIT_MS;
+   _accessPolicy=OOK_CSMA_FORCE;
+   _backoffMin=OOK_BACKOFF_MIN;
+   _backoffMax=OOK_BACKOFF_MAX;
+   _accessState=OOK_CHANNEL_READY;
+   _channelGranted=false;
+   _coexBlindMs=0;
+   _coexListenMs=OOK_FSK_LISTEN_MS;
+   _fskListen=false;
+   _lowPower=false;
+   _sleep=NULL;
+   _emitEnd=0;
+   _traceMuted=false;
+#if OOK_STATS
+   memset(&_energy, 0, sizeof(_energy));
+   _emitCarrierUsec=0;
+   _carrierUa=OOK_CARRIER_UA;
+   _txIdleUa=OOK_TX_IDLE_UA;
+   _standbyUa=OOK_STANDBY_UA;
+   _rxUa=OOK_RX_UA;
+#endif
+#if OOK_FSK_PACKETS
+   _fskHead=0;
+   _fskCount=0;
+   _fskCurrent=0;
+#endif
+   resetStats();
    pinMode(_ookDataPin, OUTPUT);
    digitalWrite(_ookDataPin,LOW);
 }
@@ -163,10 +306,25 @@ void RFM69OOK::setOokPin(uint8_t newOokDataPin)
 /***********************************************************************************************************************/
 void RFM69OOK::sendKakuNew(RFM69 &radio, unsigned long int addr, byte unit, boolean on, boolean group, byte dimLevel)
 {
-    ookPreSend (radio);									// Prepare RFM69 registers and media for OOK sending
+	OokFrame frame;
+	encodeKakuNew(frame, addr, unit, on, group, dimLevel);	// Encode the datagram once
+	sendFrame(radio, frame);								// and replay it for each repeat
+}
+/*************************************************** encodeKakuNew *****************************************************
+* Function:    Encode message datagram according to the NEW Kaku protocol
+* Parameters:
+*              	Frame to fill
+*				Handset address
+*              	Remote switch unit address
+*              	Remote switch state level
+*              	Remote switch group command option
+*              	Remote switch dim level
+/***********************************************************************************************************************/
+void RFM69OOK::encodeKakuNew(OokFrame &frame, unsigned long int addr, byte unit, boolean on, boolean group, byte dimLevel)
+{
    	/* Form  the Command datagram:
    	Unit = (-1) From 0...15
-   	Address = From 0...﻿67.108.864 shift left 6 positions
+   	Address = From 0...67.108.864 shift left 6 positions
    	DimLevel = 1 to 15
    	*/
    	if(unit !=0) unit--; 	          	        		// Set Unit address to logical
@@ -174,62 +332,10 @@ void RFM69OOK::sendKakuNew(RFM69 &radio, unsigned long int addr, byte unit, bool
     unsigned long int cmd = 0 | addr << 6 | unit;  		// Build the command datagram with the address and unit info
     if (on) cmd |= 0x10;            		      		// Set the Level bit to ON in the command datagram
     else  dimLevel = 0;                 				// Avoid DIM to be active while setting the level to OFF
-    if(RFM69OOK_DEBUG) printOokInfos(addr, unit, on, group, dimLevel,cmd);	// Print info for debugging
+    ookTrace(OOK_TRACE_ENCODE, OOK_KAKU_NEW, cmd, unit | dimLevel << 8, on | group << 1);	// Trace for debugging
 
-  	for (int i = 0; i< _repeats; i++)					// Output the data to the RFM69
-  	{
-    	ookNewKakuRfmPulse(0, _periodusec*10);        	// Send Start  bit
-    for (byte bit = 0; bit <27  ; bit++)            	// Send Address and Group bits MSB first
-    {
-      	unsigned long int level = bitRead(cmd, 31-bit) ? _periodusec*5 : _periodusec; // bit 1: 5,1: bit 0: 1,5
-      	ookNewKakuRfmPulse(level, _periodusec*6-level);
-    }
-    if (dimLevel)                                    	// Case Dim Level option
-    {
-      ookNewKakuRfmPulse(_periodusec, _periodusec);    	// Send Dimmer pulse
-      for (byte bit = 28; bit <32  ; bit++)           	// Send Unit MSB bits first
-      {
-      	unsigned long int level = bitRead(cmd, 31-bit) ? _periodusec*5 : _periodusec; // bit 1: 5,1: bit 0: 1,5
-        ookNewKakuRfmPulse(level, _periodusec*6-level);
-      }
-      for (byte bit = 0; bit < 4  ; bit++)            	// Send Dimmer Level MSB bits first
-      {
-        unsigned long int level = bitRead(dimLevel,3-bit) ? _periodusec*5 : _periodusec;// bit 1: 5,1: bit 0: 1,5
-        ookNewKakuRfmPulse(level, _periodusec*6-level);
-      }
-    }
-    else                    							// Case ON / OFF option
- 	{
-      for (byte bit = 27; bit <32  ; bit++)           	// Send Level and Unit MSB bits first
-      {
-        unsigned long int level = bitRead(cmd, 31-bit) ? _periodusec*5 : _periodusec; // bit 1: 5,1: bit 0: 1,5
-        ookNewKakuRfmPulse(level, _periodusec*6-level);
-      }
-     }
-     ookNewKakuRfmPulse(0, _periodusec*10);           	// Stop bit
-     delay (_repDly);                                 	// Wait some delay between reties 
-	}  
-    ookPostSend (radio);								// Restore RFM69 registers aftrer OOK sending                                                            
-}
- 
-/*************************************************** ookNewKakuRfmPulse ************************************************
-* Function:  	KAKU New pulse switching function
-* Parametres: 	Duration of the symbol levels
-/***********************************************************************************************************************/
-void RFM69OOK::ookNewKakuRfmPulse(int l1, int l2)
-{
- 	int corrFactor = 150;                 					// Instruction delay correction factor
- 	if (l1 != 0)       										// Skipped for Start/Stop SYNC
- 	{	
- 	 	digitalWrite(_ookDataPin,HIGH);
-		delayMicroseconds (_periodusec-corrFactor);      	// Adjusted for processing delay             
-	  	digitalWrite(_ookDataPin,LOW);
-  		delayMicroseconds (l1+corrFactor);          		// Adjusted for processing delay    
- 	}  
-  		digitalWrite(_ookDataPin,HIGH);          
-  		delayMicroseconds (_periodusec-corrFactor);  		// Adjusted for processing delay    
-  		digitalWrite(_ookDataPin,LOW);
-  		delayMicroseconds (l2+corrFactor);     			 	// Adjusted for processing delay                                     
+	encode(frame, OOK_PROTO_KAKU_NEW, cmd, 0, dimLevel);
+	frame.protocol = OOK_KAKU_NEW;
 }
 /**************************************************** sendKakuOld *******************************************************
 * Function:    	Send DATAGRAM command according to the OLD Kaku protocol
@@ -238,12 +344,23 @@ void RFM69OOK::ookNewKakuRfmPulse(int l1, int l2)
 *				House address
 *              	Remote switch unit address
 *              	Remote switch state level
-*              	Remote switch group command option
-*              	Remote switch dim level
 /***********************************************************************************************************************/
  void RFM69OOK::sendKakuOld(RFM69 &radio, char addr, byte unit, byte on)
  {
-    ookPreSend (radio);												// Prepare RFM69 registers and media for OOK sending
+	OokFrame frame;
+	encodeKakuOld(frame, addr, unit, on);				// Encode the datagram once
+	sendFrame(radio, frame);							// and replay it for each repeat
+}
+/*************************************************** encodeKakuOld *****************************************************
+* Function:    	Encode DATAGRAM command according to the OLD Kaku protocol
+* Parameters:
+*              	Frame to fill
+*				House address
+*              	Remote switch unit address
+*              	Remote switch state level
+/***********************************************************************************************************************/
+ void RFM69OOK::encodeKakuOld(OokFrame &frame, char addr, byte unit, byte on)
+ {
   	/* Form  the Command datagram:
    	Fixed float Bits = x11xxxxxxxxx (0x600) 
    	Unit = (-1) From 0...15 shift 4 bits left
@@ -252,37 +369,9 @@ void RFM69OOK::ookNewKakuRfmPulse(int l1, int l2)
    	*/
  	int cmd = 0 | 0x600 | ((unit - 1) << 4) | (addr - 65);
   	if (on) cmd |= 0x800; 
-  	if(RFM69OOK_DEBUG)	printOokInfos(addr, unit-1, on, 0, 0,cmd);	// Print info for debugging  
-  	for(int i = 0; i< _repeats; i++)
-  	{
-    	ookOldKakuRfmPulse(0, _periodusec*3);						// Start bit
-    for (byte bit = 0; bit <12 ; ++bit)
-    {
-     	int on = bitRead(cmd, bit) ? _periodusec*3 : _periodusec; 	// bit 1: 3,1(,1,3): bit 0: 1,3(,1,3)
-      	ookOldKakuRfmPulse(on, _periodusec*4-on);
-    }
-  	delay (_repDly);
-  } 
-  ookPostSend (radio);												// Restore RFM69 registers aftrer OOK sending
-  	                                                               
-}
-/************************************************ ookOldKakuRfmPulse ***************************************************
-* Function:  	KAKU Old pulse switching function with RFM69
-* Parametres: 	Duration of the symbol levels
-/***********************************************************************************************************************/
-void RFM69OOK::ookOldKakuRfmPulse(int on, int off)
-{
- 	int corrFactor = 150;                 							// Instruction delay correction factor
-  if(on !=0) {
-  	digitalWrite(_ookDataPin,HIGH);  		    // Skip the transition for the Start bit
-    delayMicroseconds (on-corrFactor);			// Adjusted for processing delay   
-  }              
-  	digitalWrite(_ookDataPin,LOW);
-  	delayMicroseconds (off+corrFactor);       						// Adjusted for processing delay      
-  	digitalWrite(_ookDataPin,HIGH);              					// Common part of any bit (1,3)
-  	delayMicroseconds ((_periodusec)-corrFactor);                       
-  	digitalWrite(_ookDataPin,LOW);
-  	delayMicroseconds (corrFactor+(_periodusec*3));
+  	ookTrace(OOK_TRACE_ENCODE, OOK_KAKU_OLD, cmd, unit - 1, on != 0);	// Trace for debugging
+	encode(frame, OOK_PROTO_KAKU_OLD, cmd, 0, 0);
+	frame.protocol = OOK_KAKU_OLD;
 }
 /****************************************************** sendKakuCogex **************************************************
 * Function:    	Send DATAGRAM command according to the COGEX Kaku protocol
@@ -291,12 +380,23 @@ void RFM69OOK::ookOldKakuRfmPulse(int on, int off)
 *				House address
 *              	Remote switch unit address
 *              	Remote switch state level
-*              	Remote switch group command option
-*              	Remote switch dim level
 /***********************************************************************************************************************/
  void RFM69OOK::sendKakuCogex(RFM69 &radio, byte addr, byte unit, byte on)
  {
-    ookPreSend (radio);												// Prepare RFM69 registers and media for OOK sending
+	OokFrame frame;
+	encodeKakuCogex(frame, addr, unit, on);				// Encode the datagram once
+	sendFrame(radio, frame);							// and replay it for each repeat
+ }
+/**************************************************** encodeKakuCogex **************************************************
+* Function:    	Encode DATAGRAM command according to the COGEX Kaku protocol
+* Parametres:
+*              	Frame to fill
+*				House address
+*              	Remote switch unit address
+*              	Remote switch state level
+/***********************************************************************************************************************/
+ void RFM69OOK::encodeKakuCogex(OokFrame &frame, byte addr, byte unit, byte on)
+ {
     /* Form  the Command datagram:
     Fixed float Bits = x11xxxxxxxxx (0x600) 
     Unit = From 1 to 15; shift 5 bits left
@@ -306,83 +406,2668 @@ void RFM69OOK::ookOldKakuRfmPulse(int on, int off)
     */ 
    int cmd = 0 | 0x600 | unit << 5 | addr << 1;
    if (on) cmd |= 0x801;
-   if(RFM69OOK_DEBUG) printOokInfos(addr, unit, on, 0, 0,cmd); 		// Print Debug infos
-   for(int i = 0; i< _repeats; i++)
-   {
-     ookCogexRfmPulse(0,_periodusec*3);                               // Start bit 
-     for (byte bit = 0; bit <12 ; ++bit)
-     {
-       int on = bitRead(cmd, bit) ? _periodusec*3 : _periodusec*1; // Float: 3,1(,1,3): bit 0: 1,3(,1,3)
-       ookCogexRfmPulse(on, _periodusec*4-on);
-    }
-  delay (_repDly);
-  } 
-  ookPostSend (radio);												// Restore RFM69 registers aftrer OOK sending
+   ookTrace(OOK_TRACE_ENCODE, OOK_KAKU_COGEX, cmd, unit, on != 0);	// Trace for debugging
+   encode(frame, OOK_PROTO_COGEX, cmd, 0, 0);
+   frame.protocol = OOK_KAKU_COGEX;
  }
-/************************************************ ookCogexRfmPulse *****************************************************
-* Function:  	KAKU Cogex pulse switching function with RFM69
-* Parameters: 	Duration of the symbol levels
 /***********************************************************************************************************************/
- void RFM69OOK::ookCogexRfmPulse(int on, int off)
+
+/******************************************************** send *********************************************************
+* Function:    	Send a datagram according to a protocol descriptor
+* Parameters:
+*              	RFM69 radio instance
+*				Protocol descriptor (OOK_PROTO_...)
+*				Datagram bits
+*				Bit mask of the bits sent as float symbols (tri-state protocols)
+*				Dim level, 0 for none (protocols with a dim extension)
+/***********************************************************************************************************************/
+void RFM69OOK::send(RFM69 &radio, const OokProtocol &protocol, unsigned long int data, unsigned long int floatMask, 
+	byte dimLevel)
+{
+	OokFrame frame;
+	encode(frame, protocol, data, floatMask, dimLevel);
+	sendFrame(radio, frame);
+}
+/******************************************************* encode ********************************************************
+* Function:    	Encode a datagram according to a protocol descriptor: lead LOW level, sync pulse, symbols, optional
+*				dim symbol and dim level bits, then tail pulse. Durations are descriptor units times _periodusec.
+* Parameters:
+*              	Frame to fill
+*				Protocol descriptor (OOK_PROTO_...), read from program memory
+*				Datagram bits
+*				Bit mask of the bits sent as float symbols (tri-state protocols)
+*				Dim level, 0 for none (protocols with a dim extension)
+/***********************************************************************************************************************/
+void RFM69OOK::encode(OokFrame &frame, const OokProtocol &protocol, unsigned long int data, unsigned long int floatMask, 
+	byte dimLevel)
+{
+	OokProtocol p;
+	memcpy_P(&p, &protocol, sizeof(p));
+	if (!(p.flags & OOK_DIM_EXT)) dimLevel = 0;
+	ookFrameBegin(frame);
+	if (p.leadLow) ookFrameAdd(frame, 0, p.leadLow * _periodusec);
+	if (p.syncHigh) ookFrameAdd(frame, p.syncHigh * _periodusec, p.syncLow * _periodusec);
+	for (byte i = 0; i < p.bits; i++)
+	{
+		byte bit = (p.flags & OOK_MSB_FIRST) ? p.bits - 1 - i : i;
+		byte symbol;
+		if (dimLevel && i == p.dimPos) symbol = OOK_SYMBOL_DIM;	// Dim symbol replaces the level bit
+		else if (bitRead(floatMask, bit)) symbol = OOK_SYMBOL_FLOAT;
+		else symbol = bitRead(data, bit);
+		ookAddSymbol(frame, p.symbol[symbol]);
+	}
+	for (byte i = 0; dimLevel && i < p.dimBits; i++)			// Dim level MSB bits first
+	{
+		ookAddSymbol(frame, p.symbol[bitRead(dimLevel, p.dimBits - 1 - i)]);
+	}
+	if (p.tailHigh) ookFrameAdd(frame, p.tailHigh * _periodusec, p.tailLow * _periodusec);
+}
+/**************************************************** ookAddSymbol *****************************************************
+* Function:  	Append the one or two HIGH/LOW pulses of a descriptor symbol to a frame
+* Parameters: 	
+*				Frame to fill
+*				HIGH, LOW, HIGH, LOW units of _periodusec (a 0 second HIGH ends the symbol)
+/***********************************************************************************************************************/
+void RFM69OOK::ookAddSymbol(OokFrame &frame, const byte *symbol)
+{
+	ookFrameAdd(frame, symbol[0] * _periodusec, symbol[1] * _periodusec);
+	if (symbol[2]) ookFrameAdd(frame, symbol[2] * _periodusec, symbol[3] * _periodusec);
+}
+/***********************************************************************************************************************/
+
+/*************************************************** ookFrameBegin *****************************************************
+* Function:  	Initialise an empty frame with the current OOK timing parameters
+* Parameters: 	Frame to initialise
+/***********************************************************************************************************************/
+void RFM69OOK::ookFrameBegin(OokFrame &frame)
+{
+	frame.periodusec = _periodusec;
+	frame.repeats = _repeats;
+	frame.repDly = _repDly;
+	frame.length = 0;
+	frame.protocol = OOK_OTHER;
+}
+/**************************************************** ookFrameAdd ******************************************************
+* Function:  	Append a HIGH then LOW duration to a frame
+* Parameters: 	
+*				Frame to fill
+*				HIGH and LOW durations in us
+/***********************************************************************************************************************/
+void RFM69OOK::ookFrameAdd(OokFrame &frame, unsigned int high, unsigned int low)
+{
+	if (frame.length > OOK_FRAME_MAX_EDGES - 2) return;			// Frame full, should not happen with the Kaku protocols
+	frame.dur[frame.length++] = high;
+	frame.dur[frame.length++] = low;
+}
+/****************************************************** sendFrame ******************************************************
+* Function:  	Send an encoded OOK frame, repeated according to the frame timing parameters
+* Parameters: 	
+*				RFM69 radio instance
+*				Encoded frame
+/***********************************************************************************************************************/
+void RFM69OOK::sendFrame(RFM69 &radio, const OokFrame &frame)
+{
+	if (!ookPreSend (radio)) return;					// Prepare RFM69 registers and media for OOK sending
+	ookSendRepeats(radio, frame);
+	ookPostSend (radio);								// Restore RFM69 registers after OOK sending
+}
+/***************************************************** sendCapture *****************************************************
+* Function:  	Send a raw capture, repeated according to its timing parameters. The durations are read from program 
+*				memory while the edges are output, the capture is never copied to RAM. Raw captures are always output 
+*				on the DIO2 pin, whatever the selected backend.
+* Parameters: 	
+*				RFM69 radio instance
+*				Raw capture located in program memory (see encodeCapture)
+/***********************************************************************************************************************/
+void RFM69OOK::sendCapture(RFM69 &radio, const byte *capture)
+{
+	byte backend = _txBackend;
+	_txBackend = OOK_BACKEND_DIO2;
+	boolean granted = ookPreSend (radio);				// Prepare RFM69 registers and media for OOK sending
+	_txBackend = backend;
+	if (!granted) return;
+	byte repeats = pgm_read_byte(capture + OOK_CAPTURE_REPEATS);
+	byte repDly = pgm_read_byte(capture + OOK_CAPTURE_REPDLY);
+	ookTraceSend(OOK_OTHER, 0, repeats, repDly, pgm_read_byte(capture + OOK_CAPTURE_LENGTH) | 
+		(pgm_read_byte(capture + OOK_CAPTURE_LENGTH + 1) << 8));
+#if OOK_STATS
+	unsigned long int start = micros();
+#endif
+	for (byte i = 0; i < repeats; i++)
+	{
+		unsigned long int frameStart = millis();
+		ookEmitCapture(capture);						// Output the data to the RFM69
+		ookRepeatGap(radio, repDly, millis() - frameStart, i + 1 == repeats);	// Wait some delay between retries
+	}
+#if OOK_STATS
+	ookStatsFrame(OOK_OTHER, repeats, micros() - start);
+#endif
+	ookPostSend (radio);								// Restore RFM69 registers after OOK sending
+}
+/**************************************************** encodeCapture ****************************************************
+* Function:  	Encode recorded edge times into a raw capture with the current repeats and repDly. The durations 
+*				between edges are grouped in at most OOK_CAPTURE_SYMBOLS values, a duration joining the first value 
+*				within OOK_CAPTURE_TOLERANCE %, then each duration is replaced by the index of its nearest value. 
+*				An odd number of durations is completed by a 0 LOW duration. The capture is meant to be printed and 
+*				stored in program memory (PROGMEM) to be sent by sendCapture.
+* Parameters: 	
+*				Capture buffer to fill
+*				Capture buffer size (bytes)
+*				Edge times (us), the first edge is a rising one, the last one ends the last LOW level
+*				Number of edge times
+* Returns:		Capture size (bytes), 0 if the durations need too many values or the buffer is too small
+/***********************************************************************************************************************/
+unsigned int RFM69OOK::encodeCapture(byte *capture, unsigned int size, const unsigned long int *edges, 
+	unsigned int count)
+{
+	if (count < 2) return 0;
+	unsigned int length = count & ~1;						// count - 1 durations completed to an even number
+	unsigned int table[OOK_CAPTURE_SYMBOLS];
+	unsigned long int sum[OOK_CAPTURE_SYMBOLS];
+	unsigned int weight[OOK_CAPTURE_SYMBOLS];
+	byte symbols = 0;
+	for (unsigned int i = 0; i < length; i++)				// Group the durations
+	{
+		unsigned int dur = ookCaptureDuration(edges, count, i);
+		byte s = 0;
+		while (s < symbols && (unsigned long int)abs((long)dur - (long)table[s]) * 100 > 
+			(unsigned long int)table[s] * OOK_CAPTURE_TOLERANCE) s++;
+		if (s == symbols)
+		{
+			if (symbols == OOK_CAPTURE_SYMBOLS) return 0;	// Too many different durations
+			sum[s] = 0;
+			weight[s] = 0;
+			symbols++;
+		}
+		sum[s] += dur;
+		weight[s]++;
+		table[s] = sum[s] / weight[s];
+	}
+	byte bits = OOK_CAPTURE_BITS(symbols);
+	unsigned int total = OOK_CAPTURE_HEADER + 2 * symbols + ((unsigned long int)length * bits + 7) / 8;
+	if (total > size) return 0;
+	capture[OOK_CAPTURE_REPEATS] = _repeats;
+	capture[OOK_CAPTURE_REPDLY] = _repDly;
+	capture[OOK_CAPTURE_COUNT] = symbols;
+	capture[OOK_CAPTURE_LENGTH] = lowByte(length);
+	capture[OOK_CAPTURE_LENGTH + 1] = highByte(length);
+	byte *out = capture + OOK_CAPTURE_HEADER;
+	for (byte s = 0; s < symbols; s++)
+	{
+		*out++ = lowByte(table[s]);
+		*out++ = highByte(table[s]);
+	}
+	byte shift = 8;
+	*out = 0;
+	for (unsigned int i = 0; i < length; i++)				// Pack the index of the nearest value
+	{
+		unsigned int dur = ookCaptureDuration(edges, count, i);
+		byte nearest = 0;
+		for (byte s = 1; s < symbols; s++)
+		{
+			if (abs((long)dur - (long)table[s]) < abs((long)dur - (long)table[nearest])) nearest = s;
+		}
+		if (shift == 0)
+		{
+			*++out = 0;
+			shift = 8;
+		}
+		shift -= bits;
+		*out |= nearest << shift;
+	}
+	return total;
+}
+/************************************************** ookCaptureDuration *************************************************
+* Function:  	Duration between two recorded edges, limited to 16 bits
+* Parameters: 	
+*				Edge times (us)
+*				Number of edge times
+*				Index of the duration, a duration past the last edge is 0
+/***********************************************************************************************************************/
+unsigned int RFM69OOK::ookCaptureDuration(const unsigned long int *edges, unsigned int count, unsigned int i)
+{
+	if (i + 1 >= count) return 0;
+	unsigned long int dur = edges[i + 1] - edges[i];
+	return dur > 0xFFFF ? 0xFFFF : dur;
+}
+/*************************************************** ookEmitRepeats ****************************************************
+* Function:  	Output an encoded frame the number of times given by the frame timing parameters
+* Parameters: 	
+*				RFM69 radio instance
+*				Encoded frame
+/***********************************************************************************************************************/
+void RFM69OOK::ookEmitRepeats(RFM69 &radio, const OokFrame &frame)
+{
+	for (byte i = 0; i < frame.repeats; i++)
+	{
+		unsigned long int start = millis();
+		ookEmitFrame(frame);							// Output the data to the RFM69
+		ookRepeatGap(radio, frame.repDly, millis() - start, i + 1 == frame.repeats);	// Wait some delay between retries
+	}
+}
+/**************************************************** ookRepeatGap *****************************************************
+* Function:  	Wait the delay following a repeat. With the coexistence enabled, the delay is given to FSK reception
+*				when the next repeat would make the FSK blind window longer than the configured limit. No FSK 
+*				reception follows the last repeat, the sending ends and restores the RFM69 right after its delay. 
+*				In low power mode, the RFM69 is put in standby for the gap (see setLowPower).
+* Parameters: 	
+*				RFM69 radio instance
+*				Repeat delay (ms)
+*				Transmit time of the last repeat (ms)
+*				true after the last repeat of the sending
+/***********************************************************************************************************************/
+void RFM69OOK::ookRepeatGap(RFM69 &radio, byte repDly, unsigned long int frameMs, boolean last)
+{
+#if OOK_FSK_PACKETS
+	if (!last && _coexBlindMs && millis() - _blindStart + repDly + frameMs > _coexBlindMs)
+	{
+#if OOK_STATS
+		unsigned long int start = micros();
+#endif
+		ookFskGap(radio, repDly < _coexListenMs ? _coexListenMs : repDly);
+#if OOK_STATS
+		_energy.rxUsec += micros() - start;
+#endif
+		return;
+	}
+#else
+	(void) frameMs, (void) last;
+#endif
+	if (!_lowPower)
+	{
+		delay (repDly);
+		return;
+	}
+	unsigned long int end = _emitEnd + repDly * 1000UL;		// The last LOW level is part of the gap
+	if ((long)(end - micros()) >= OOK_STANDBY_MIN_USEC) ookStandbyGap(radio, end);
+	else while ((long)(micros() - end) < 0);
+}
+/*************************************************** ookStandbyGap *****************************************************
+* Function:  	Put the RFM69 in standby (synthesizer and PA off, DIO2 stays LOW) and the MCU to sleep until 
+*				OOK_WAKE_USEC before the end of a repeat gap, then set the transmit mode back and wait for it to be 
+*				ready so that the next repeat starts on time
+* Parameters: 	
+*				RFM69 radio instance
+*				End time of the gap (us)
+/***********************************************************************************************************************/
+void RFM69OOK::ookStandbyGap(RFM69 &radio, unsigned long int end)
+{
+#if OOK_STATS
+	unsigned long int start = micros();
+#endif
+	ookWriteReg(radio, REG_OPMODE, RF_OPMODE_STANDBY);
+	unsigned long int wake = end - OOK_WAKE_USEC;
+	long left = (long)(wake - micros());
+	if (left > 0)
+	{
+		if (_sleep)
+		{
+#if OOK_STATS
+			unsigned long int sleepStart = micros();
+#endif
+			_sleep(left);
+#if OOK_STATS
+			_energy.sleepUsec += micros() - sleepStart;
+#endif
+		}
+		else delay(left / 1000);
+	}
+	while ((long)(micros() - wake) < 0);
+	ookWriteReg(radio, REG_OPMODE, RF_OPMODE_TRANSMITTER);
+	while (!(ookReadReg(radio, REG_IRQFLAGS1) & RF_IRQFLAGS1_MODEREADY) && (long)(micros() - end) < 0);
+#if OOK_STATS
+	_energy.standbyUsec += micros() - start;
+#endif
+	while ((long)(micros() - end) < 0);
+}
+/***************************************************** setLowPower *****************************************************
+* Function:  	Put the RFM69 in standby during the repeat gaps of the blocking DIO2 sendings (send..., sendFrame, 
+*				flush, sendCapture) instead of leaving it in transmit mode with the carrier off. The last LOW level of 
+*				a repeat is part of its gap. Gaps shorter than OOK_STANDBY_MIN_USEC are waited in transmit mode. 
+*				The MCU sleep function, when given, is called for each gap with the time left before the RFM69 
+*				wake up: it must sleep at most this time, woken by a timer, with micros() still counting (AVR idle 
+*				mode, ESP32 light sleep). The FIFO backend and the asynchronous sendings are not changed.
+* Parameters: 	
+*				true to enable the low power mode
+*				MCU sleep function, NULL to wait with delay
+/***********************************************************************************************************************/
+void RFM69OOK::setLowPower(boolean enable, OokSleepFunction sleep)
+{
+	_lowPower = enable;
+	_sleep = sleep;
+}
+/************************************************** setSupplyCurrents **************************************************
+* Function:  	Set the RFM69 supply currents used to estimate the charge of a sending (see lastEnergy). The defaults
+*				are the RFM69W datasheet values at +13 dBm, a RFM69HW with the PA boost draws much more.
+* Parameters: 	
+*				Carrier on current (uA)
+*				Transmit mode current with the carrier off (uA)
+*				Standby current (uA)
+*				Receive current (uA)
+/***********************************************************************************************************************/
+void RFM69OOK::setSupplyCurrents(unsigned long int carrierUa, unsigned long int txIdleUa, unsigned long int standbyUa,
+	unsigned long int rxUa)
+{
+#if OOK_STATS
+	_carrierUa = carrierUa;
+	_txIdleUa = txIdleUa;
+	_standbyUa = standbyUa;
+	_rxUa = rxUa;
+#else
+	(void) carrierUa, (void) txIdleUa, (void) standbyUa, (void) rxUa;
+#endif
+}
+/***************************************************** lastEnergy *****************************************************
+* Function:  	Transmit time and estimated RFM69 charge of the last sending (send..., sendFrame, sendCapture, a flush
+*				as a whole or an asynchronous sending once terminated), from ookPreSend to ookPostSend. Comparing the 
+*				charge with and without setLowPower shows the saving. With OOK_STATS set to 0 nothing is measured.
+* Parameters: 	None
+/***********************************************************************************************************************/
+const OokEnergy &RFM69OOK::lastEnergy()
+{
+#if OOK_STATS
+	return _energy;
+#else
+	static const OokEnergy none = {};
+	return none;
+#endif
+}
+#if OOK_STATS
+/***************************************************** ookEnergyEnd ****************************************************
+* Function:  	Terminate the energy report of the sending: the transmit time is the sending time less the standby 
+*				and receive gaps, the charge adds each time multiplied by its supply current
+* Parameters: 	None
+/***********************************************************************************************************************/
+void RFM69OOK::ookEnergyEnd()
+{
+	OokEnergy &e = _energy;
+	e.txOnUsec = micros() - _txModeStart - e.standbyUsec - e.rxUsec;
+	e.carrierUsec = _emitCarrierUsec < e.txOnUsec ? _emitCarrierUsec : e.txOnUsec;
+	e.chargeUc = ookCharge(e.carrierUsec, _carrierUa) + ookCharge(e.txOnUsec - e.carrierUsec, _txIdleUa) + 
+		ookCharge(e.standbyUsec, _standbyUa) + ookCharge(e.rxUsec, _rxUa);
+}
+/*************************************************** ookFrameCarrier ***************************************************
+* Function:  	Carrier on time of an encoded frame sent without ookEmitWith (FIFO backend, asynchronous sending, 
+*				RFM69OOKMulti)
+* Parameters: 	Encoded frame
+* Returns:		Sum of the HIGH durations times the number of repeats (us)
+/***********************************************************************************************************************/
+unsigned long int RFM69OOK::ookFrameCarrier(const OokFrame &frame)
+{
+	unsigned long int high = 0;
+	for (byte i = 0; i < frame.length; i += 2) high += frame.dur[i];
+	return high * frame.repeats;
+}
+/****************************************************** ookCharge ******************************************************
+* Function:  	Charge drawn by a current during a time, computed in ms and mA parts to stay within 32 bits
+* Parameters: 	
+*				Time (us)
+*				Current (uA)
+* Returns:		Charge (uC)
+/***********************************************************************************************************************/
+unsigned long int RFM69OOK::ookCharge(unsigned long int usec, unsigned long int ua)
+{
+	return (usec / 1000) * (ua / 1000) + ((usec / 1000) * (ua % 1000) + (usec % 1000) * (ua / 1000)) / 1000;
+}
+#endif
+/***************************************************** getStats ********************************************************
+* Function:  	Cumulative transmit telemetry since the last resetStats, cheap enough to be polled. Frames sent by 
+*				sendFrame, flush and the asynchronous functions are counted once sent. With OOK_STATS set to 0 
+*				nothing is counted and the returned counters stay at zero.
+* Parameters: 	None
+/***********************************************************************************************************************/
+const OokStats &RFM69OOK::getStats()
+{
+#if OOK_STATS
+	_stats.regReads = _regReads;
+	_stats.regWrites = _regWrites;
+	return _stats;
+#else
+	static const OokStats none = {};
+	return none;
+#endif
+}
+/**************************************************** resetStats *******************************************************
+* Function:  	Clear the transmit telemetry
+* Parameters: 	None
+/***********************************************************************************************************************/
+void RFM69OOK::resetStats()
+{
+#if OOK_STATS
+	memset(&_stats, 0, sizeof(_stats));
+	_emitLateUsec = 0;
+	_regReads = 0;
+	_regWrites = 0;
+#endif
+}
+#if OOK_STATS
+/*************************************************** ookStatsFrame *****************************************************
+* Function:  	Count a sent frame in its protocol slot and in the totals
+* Parameters: 	
+*				Telemetry slot of the frame
+*				Number of repeats sent
+*				Transmit time of all its repeats (us)
+/***********************************************************************************************************************/
+void RFM69OOK::ookStatsFrame(byte protocol, byte repeats, unsigned long int txOnUsec)
+{
+	OokProtocolStats *slots[2] = { &_stats.protocols[protocol < OOK_PROTOCOLS ? protocol : OOK_OTHER], &_stats.total };
+	for (byte i = 0; i < 2; i++)
+	{
+		slots[i]->frames++;
+		slots[i]->repeats += repeats;
+		slots[i]->txOnUsec += txOnUsec;
+	}
+	if (_emitLateUsec > _stats.maxLateUsec) _stats.maxLateUsec = _emitLateUsec;
+}
+/**************************************************** ookStatsCsma *****************************************************
+* Function:  	Count a clear channel wait in the histogram
+* Parameters: 	
+*				Wait time (ms)
+*				true if the wait reached the access time limit without a clear channel
+/***********************************************************************************************************************/
+void RFM69OOK::ookStatsCsma(unsigned long int waitMs, boolean timeout)
+{
+	byte bucket = 0;
+	while (bucket < OOK_CSMA_BUCKETS - 1 && waitMs > ookCsmaBuckets[bucket]) bucket++;
+	_stats.csmaWaits[bucket]++;
+	if (timeout) _stats.csmaTimeouts++;
+}
+#endif
+/*************************************************** setOokBackend *****************************************************
+* Function:  	Select the transmit backend:
+*				- OOK_BACKEND_DIO2: the processor outputs the frame edges on the RFM69 DIO2 pin (default)
+*				- OOK_BACKEND_FIFO: the frame is expanded in a chip stream at a bit rate of 1/_periodusec and 
+*				  clocked out by the RFM69 packet engine from its FIFO, no DIO2 connection is needed. The OOK pulse 
+*				  time is limited to OOK_FIFO_MAX_PERIOD and OOK_PULSE_TRIM is not applied.
+* Parameters: 	Backend
+/***********************************************************************************************************************/
+void RFM69OOK::setOokBackend(byte backend)
+{
+	_txBackend = backend;
+}
+#if OOK_TRACE_SIZE
+/**************************************************** ookTraceAdd ******************************************************
+* Function:  	Add an event to the trace ring, the oldest event is overwritten when the ring is full
+* Parameters: 	Event, protocol, command word, parameters and outcome (see OokTraceEntry)
+/***********************************************************************************************************************/
+void RFM69OOK::ookTraceAdd(byte event, byte protocol, unsigned long int cmd, unsigned int param, byte outcome)
+{
+	OokTraceEntry *entry = &_trace[(_traceHead + _traceCount) & (OOK_TRACE_SIZE - 1)];
+	if (_traceCount < OOK_TRACE_SIZE) _traceCount++;
+	else
+	{
+		_traceHead = (_traceHead + 1) & (OOK_TRACE_SIZE - 1);
+		_traceLost++;
+	}
+	entry->time = micros();
+	entry->cmd = cmd;
+	entry->param = param;
+	entry->event = event;
+	entry->protocol = protocol;
+	entry->outcome = outcome;
+}
+#endif
+/***************************************************** dumpTrace *******************************************************
+* Function:  	Print the recorded trace events, oldest first, then forget them. The events are recorded while 
+*				RFM69OOK_DEBUG is set by writing a few bytes in a ring of OOK_TRACE_SIZE entries, so this is the only
+*				place where the Serial output takes time: call it outside of time critical code.
+* Parameters: 	Output stream (Serial)
+* Returns:		Number of printed events
+/***********************************************************************************************************************/
+byte RFM69OOK::dumpTrace(Stream &out)
+{
+#if OOK_TRACE_SIZE
+	byte printed = 0;
+	if (_traceLost) out.print(F("Trace events lost: ")), out.println(_traceLost);
+	_traceLost = 0;
+	while (_traceCount)
+	{
+		OokTraceEntry entry = _trace[_traceHead];
+		_traceHead = (_traceHead + 1) & (OOK_TRACE_SIZE - 1);
+		_traceCount--;
+		printed++;
+		out.print(entry.time), out.print(F(" us "));
+		switch (entry.protocol)
+		{
+			case OOK_KAKU_NEW:		out.print(F("New ")); break;
+			case OOK_KAKU_OLD:		out.print(F("Old ")); break;
+			case OOK_KAKU_COGEX:	out.print(F("Cogex ")); break;
+			default:				if (entry.event != OOK_TRACE_ACCESS) out.print(F("Other ")); break;
+		}
+		switch (entry.event)
+		{
+			case OOK_TRACE_ENCODE:
+				out.print(F("encoded, Logical Unit: ")), out.print(entry.param & 0xFF);
+				out.print(F(" to: ")), out.print(entry.outcome & 1);
+				if (entry.outcome & 2) out.print(F(" Group"));
+				if (entry.param >> 8) out.print(F(" DIM level: ")), out.print(entry.param >> 8);
+				out.print(F(" Command datagram: ")), out.println(entry.cmd, BIN);
+				break;
+			case OOK_TRACE_SEND:
+				out.print(F("sending, Period: ")), out.print(entry.cmd & 0xFFFF);
+				out.print(F("; Repeated: ")), out.print((entry.cmd >> 16) & 0xFF);
+				out.print(F("; Delay: ")), out.print(entry.cmd >> 24);
+				out.print(F("; Durations: ")), out.print(entry.param);
+				out.println(entry.outcome == OOK_BACKEND_FIFO ? F("; FIFO") : F("; DIO2"));
+				break;
+			case OOK_TRACE_ACCESS:
+				out.print(F("Channel access after ")), out.print(entry.param), out.print(F(" ms: "));
+				switch (entry.outcome)
+				{
+					case OOK_CHANNEL_READY:		out.println(F("clear")); break;
+					case OOK_CHANNEL_FORCED:	out.println(F("forced")); break;
+					case OOK_CHANNEL_DROPPED:	out.println(F("dropped")); break;
+					default:					out.println(F("deferred")); break;
+				}
+				break;
+		}
+	}
+	return printed;
+#else
+	(void) out;
+	return 0;
+#endif
+}
+/*************************************************** setCoexistence ****************************************************
+* Function:  	Receive FSK packets between the repeats of the blocking DIO2 sendings (send..., sendFrame, flush, 
+*				sendCapture). Repeats are sent back to back as long as the FSK blind window (OOK transmission 
+*				without FSK reception) stays within maxBlindMs, then the RFM69 is switched back to its recorded FSK 
+*				modulation in receive mode for the repeat delay (at least listenMs) and the RFM69 library receiveDone
+*				is serviced. Received packets are kept for fskReceiveDone and the RFM69 is left receiving after the 
+*				sending. A window shorter than one repeat is not split. ACKs are not sent during the sending.
+* Parameters: 	
+*				Longest FSK blind window (ms), 0 to disable the coexistence
+*				Shortest FSK reception time between two repeats (ms)
+/***********************************************************************************************************************/
+void RFM69OOK::setCoexistence(unsigned int maxBlindMs, byte listenMs)
+{
+	_coexBlindMs = maxBlindMs;
+	_coexListenMs = listenMs;
+}
+/*************************************************** fskReceiveDone ****************************************************
+* Function:  	Check for a FSK packet received between OOK repeats, the oldest one is then given by getFskPacket
+* Parameters: 	None
+* Returns:		true if a packet is reported
+/***********************************************************************************************************************/
+boolean RFM69OOK::fskReceiveDone()
+{
+#if OOK_FSK_PACKETS
+	if (_fskCount == 0) return false;
+	_fskCurrent = _fskHead;
+	_fskHead = (_fskHead + 1) % OOK_FSK_PACKETS;
+	_fskCount--;
+	return true;
+#else
+	return false;
+#endif
+}
+/**************************************************** getFskPacket *****************************************************
+* Function:  	FSK packet reported by the last fskReceiveDone, valid until the next OOK sending
+* Parameters: 	None
+/***********************************************************************************************************************/
+const OokFskPacket &RFM69OOK::getFskPacket()
+{
+#if OOK_FSK_PACKETS
+	return _fskPackets[_fskCurrent];
+#else
+	static const OokFskPacket none = {};
+	return none;
+#endif
+}
+#if OOK_FSK_PACKETS
+/***************************************************** ookFskGap *******************************************************
+* Function:  	Switch the RFM69 to its recorded FSK modulation in receive mode for a gap between two OOK repeats, 
+*				keep the packets reported by the RFM69 library, then switch back to OOK transmission. A packet whose
+*				sync word is matched when the gap ends is cut by the next repeat and counted as missed.
+* Parameters: 	
+*				RFM69 radio instance
+*				Gap duration (ms)
+/***********************************************************************************************************************/
+void RFM69OOK::ookFskGap(RFM69 &radio, unsigned int gapMs)
+{
+	unsigned long int start = millis();
+#if OOK_STATS
+	_stats.fskGaps++;
+	if (start - _blindStart > _stats.maxBlindMs) _stats.maxBlindMs = start - _blindStart;
+#endif
+	ookWriteReg(radio, REG_OPMODE, RF_OPMODE_STANDBY);
+	ookWriteReg(radio, REG_DATAMODUL, _modulation);			// Recorded FSK modulation (the bit rate is unchanged)
+	ookWriteReg(radio, REG_OPMODE, RF_OPMODE_RECEIVER);
+	_fskListen = true;
+	while (millis() - start < gapMs)
+	{
+		if (!radio.receiveDone()) continue;					// The RFM69 library also enters receive mode here
+		if (_fskCount == OOK_FSK_PACKETS)
+		{
+#if OOK_STATS
+			_stats.fskMissed++;								// Packet buffer full
+#endif
+			continue;
+		}
+		OokFskPacket &packet = _fskPackets[(_fskHead + _fskCount++) % OOK_FSK_PACKETS];
+		packet.senderId = radio.SENDERID;
+		packet.targetId = radio.TARGETID;
+		packet.dataLen = radio.DATALEN;
+		packet.ackRequested = radio.ACKRequested();
+		packet.rssi = radio.RSSI;
+		memcpy(packet.data, (const void *)radio.DATA, radio.DATALEN);
+#if OOK_STATS
+		_stats.fskReceived++;
+#endif
+	}
+#if OOK_STATS
+	if (ookReadReg(radio, REG_IRQFLAGS1) & RF_IRQFLAGS1_SYNCADDRESSMATCH) _stats.fskMissed++;
+#endif
+	_regValid &= ~_BV(OOK_SLOT_OPMODE);						// Changed by the RFM69 library
+	ookWriteReg(radio, REG_OPMODE, RF_OPMODE_STANDBY);
+	ookWriteReg(radio, REG_DATAMODUL, RF_DATAMODUL_DATAMODE_CONTINUOUSNOBSYNC|RF_DATAMODUL_MODULATIONTYPE_OOK);
+	ookWriteReg(radio, REG_OPMODE, RF_OPMODE_TRANSMITTER);
+	_blindStart = millis();
+}
+#endif
+/************************************************** setChannelAccess ***************************************************
+* Function:  	Set the channel access done before each sending. The channel is clear when the RSSI is below the 
+*				threshold, with a 0 threshold the RFM69 library canSend test is used. When the channel stays busy up 
+*				to the time limit, the policy decides of the sending:
+*				- OOK_CSMA_FORCE: the frame is sent anyway (default)
+*				- OOK_CSMA_DROP: the frame is not sent, queued commands are dropped
+*				- OOK_CSMA_DEFER: the frame is not sent, queued commands are kept and an asynchronous sending 
+*				  starts a new channel access
+* Parameters: 	
+*				RSSI threshold (dBm), 0 for the canSend test
+*				Access time limit (ms)
+*				Busy channel policy
+/***********************************************************************************************************************/
+void RFM69OOK::setChannelAccess(int rssiThreshold, unsigned int limitMs, byte policy)
+{
+	_rssiThreshold = rssiThreshold;
+	_accessLimitMs = limitMs;
+	_accessPolicy = policy;
+}
+/***************************************************** setBackoff ******************************************************
+* Function:  	Set the range of the random delay between two RSSI samples of a busy channel
+* Parameters: 	
+*				Shortest backoff (ms)
+*				Longest backoff (ms)
+/***********************************************************************************************************************/
+void RFM69OOK::setBackoff(byte minMs, byte maxMs)
+{
+	_backoffMin = minMs;
+	_backoffMax = maxMs < minMs ? minMs : maxMs;
+}
+/*************************************************** channelAccess *****************************************************
+* Function:  	Sample the channel without blocking. A new channel access starts when none is in progress, the RSSI 
+*				is then sampled at each call after a random backoff following a busy sample. A clear (or forced) 
+*				result is used by a sending started within OOK_GRANT_MS, without sampling the channel again.
+* Parameters: 	RFM69 radio instance
+* Returns:		OOK_CHANNEL_BUSY while the channel access is in progress, then OOK_CHANNEL_READY for a clear channel
+*				or, at the time limit, OOK_CHANNEL_FORCED, OOK_CHANNEL_DROPPED or OOK_CHANNEL_DEFERRED by the policy
+/***********************************************************************************************************************/
+byte RFM69OOK::channelAccess(RFM69 &radio)
+{
+	unsigned long int now = millis();
+	if (_accessState != OOK_CHANNEL_BUSY)						// Start a new channel access
+	{
+		_accessState = OOK_CHANNEL_BUSY;
+		_channelGranted = false;
+		_accessStart = now;
+		_accessNext = now;
+	}
+	if ((long)(now - _accessNext) < 0) return OOK_CHANNEL_BUSY;	// Backoff in progress
+	boolean clear;
+	if (_rssiThreshold == 0)
+	{
+		clear = radio.canSend();
+		if (!clear) radio.receiveDone();
+	}
+	else
+	{
+		radio.receiveDone();									// The RSSI is measured in receive mode
+		clear = radio.readRSSI() < _rssiThreshold;
+	}
+	if (clear) return ookAccessEnd(OOK_CHANNEL_READY);
+	if (now - _accessStart >= _accessLimitMs)
+	{
+		switch (_accessPolicy)
+		{
+			case OOK_CSMA_DROP:
+				return ookAccessEnd(OOK_CHANNEL_DROPPED);
+			case OOK_CSMA_DEFER:
+				return ookAccessEnd(OOK_CHANNEL_DEFERRED);
+			default:
+				return ookAccessEnd(OOK_CHANNEL_FORCED);
+		}
+	}
+	_accessNext = now + random(_backoffMin, _backoffMax + 1);
+	return OOK_CHANNEL_BUSY;
+}
+/************************************************* lastChannelAccess ***************************************************
+* Function:  	Result of the last terminated channel access
+* Parameters: 	None
+* Returns:		OOK_CHANNEL_READY, OOK_CHANNEL_FORCED, OOK_CHANNEL_DROPPED or OOK_CHANNEL_DEFERRED, 
+*				OOK_CHANNEL_BUSY while a channel access is in progress
+/***********************************************************************************************************************/
+byte RFM69OOK::lastChannelAccess()
+{
+	return _accessState;
+}
+/*************************************************** ookAccessEnd ******************************************************
+* Function:  	Terminate the channel access, count its wait and grant the channel to the next sending. A dropped or 
+*				deferred sending forgets the register shadow cache.
+* Parameters: 	Result
+* Returns:		Result
+/***********************************************************************************************************************/
+byte RFM69OOK::ookAccessEnd(byte result)
+{
+	_accessState = result;
+	_grantTime = millis();
+#if OOK_STATS
+	ookStatsCsma(_grantTime - _accessStart, result != OOK_CHANNEL_READY);
+#endif
+	_channelGranted = (result == OOK_CHANNEL_READY || result == OOK_CHANNEL_FORCED);
+	if (!_channelGranted) _regValid = 0;						// Registers may be changed by the RFM69 library
+	unsigned long int wait = _grantTime - _accessStart;
+	ookTrace(OOK_TRACE_ACCESS, OOK_OTHER, 0, wait > 0xFFFF ? 0xFFFF : wait, result);
+	return result;
+}
+/************************************************** ookWaitChannel *****************************************************
+* Function:  	Wait for the channel access of a sending, unless channelAccess has just granted the channel
+* Parameters: 	RFM69 radio instance
+* Returns:		false if the sending is dropped or deferred
+/***********************************************************************************************************************/
+boolean RFM69OOK::ookWaitChannel(RFM69 &radio)
+{
+	boolean granted = _channelGranted && millis() - _grantTime < OOK_GRANT_MS;
+	_channelGranted = false;									// A grant is used by one sending only
+	if (granted) return true;
+	byte result;
+	while ((result = channelAccess(radio)) == OOK_CHANNEL_BUSY);
+	_channelGranted = false;
+	return result == OOK_CHANNEL_READY || result == OOK_CHANNEL_FORCED;
+}
+/*************************************************** ookSendRepeats ****************************************************
+* Function:  	Send an encoded frame for each repeat with the backend prepared by ookPreSend
+* Parameters: 	
+*				RFM69 radio instance
+*				Encoded frame
+/***********************************************************************************************************************/
+void RFM69OOK::ookSendRepeats(RFM69 &radio, const OokFrame &frame)
+{
+#if OOK_STATS
+	unsigned long int start = micros();
+#endif
+	ookTraceSend(frame.protocol, frame.periodusec, frame.repeats, frame.repDly, frame.length);
+	if (!_fifoActive) ookEmitRepeats(radio, frame);
+	else
+	{
+		if (!ookFifoStart(radio, frame)) return;
+		while (ookFifoService(radio));					// Refill the FIFO until the last chip is sent
+		ookWriteReg(radio, REG_OPMODE, RF_OPMODE_STANDBY);
+#if OOK_STATS
+		_emitCarrierUsec += ookFrameCarrier(frame);
+#endif
+	}
+#if OOK_STATS
+	ookStatsFrame(frame.protocol, frame.repeats, micros() - start);
+#endif
+}
+/**************************************************** ookFifoStart *****************************************************
+* Function:  	Set the bit rate for the frame pulse time, fill the FIFO with the first chips and start transmitting
+* Parameters: 	
+*				RFM69 radio instance
+*				Encoded frame, must stay valid until the sending is terminated
+* Returns:		false if the frame cannot be sent through the FIFO
+/***********************************************************************************************************************/
+boolean RFM69OOK::ookFifoStart(RFM69 &radio, const OokFrame &frame)
+{
+	if (frame.repeats == 0 || frame.periodusec == 0 || frame.periodusec > OOK_FIFO_MAX_PERIOD) return false;
+	unsigned int bitRate = frame.periodusec * 32;		// 32 MHz oscillator / (1 / _periodusec)
+	ookWriteReg(radio, REG_BITRATEMSB, bitRate >> 8);
+	ookWriteReg(radio, REG_BITRATELSB, bitRate & 0xFF);
+	_txFrame = &frame;
+	_txIndex = 0;
+	_txRepeat = 0;
+	_fifoChips = 0;
+	_fifoEnd = false;
+	ookWriteReg(radio, REG_IRQFLAGS2, RF_IRQFLAGS2_FIFOOVERRUN);	// Clear the FIFO
+	byte value;
+	for (byte i = 0; i < OOK_FIFO_SIZE && !_fifoEnd; i++)
+	{
+		if (ookFifoNextByte(value)) ookWriteReg(radio, REG_FIFO, value);
+	}
+	_fifoLastBusy = micros();
+	ookWriteReg(radio, REG_OPMODE, RF_OPMODE_TRANSMITTER);		// Transmission starts with a non empty FIFO
+	return true;
+}
+/*************************************************** ookFifoService ****************************************************
+* Function:  	Refill the FIFO each time its level falls to OOK_FIFO_THRESHOLD, then wait for the last chip to be sent
+* Parameters: 	RFM69 radio instance
+* Returns:		true while the frame is being sent
+/***********************************************************************************************************************/
+boolean RFM69OOK::ookFifoService(RFM69 &radio)
+{
+	byte flags = ookReadReg(radio, REG_IRQFLAGS2);
+	if (!_fifoEnd)
+	{
+		if (flags & RF_IRQFLAGS2_FIFOLEVEL) return true;	// More than OOK_FIFO_THRESHOLD bytes still to send
+		byte value;
+		for (byte i = 0; i < OOK_FIFO_SIZE - OOK_FIFO_THRESHOLD - 1 && !_fifoEnd; i++)
+		{
+			if (ookFifoNextByte(value)) ookWriteReg(radio, REG_FIFO, value);
+		}
+		_fifoLastBusy = micros();
+		return true;
+	}
+	if (flags & RF_IRQFLAGS2_FIFONOTEMPTY)
+	{
+		_fifoLastBusy = micros();
+		return true;
+	}
+	// The last byte leaves the FIFO before its chips are sent
+	return micros() - _fifoLastBusy < 9UL * _txFrame->periodusec;
+}
+/*************************************************** ookFifoNextByte ***************************************************
+* Function:  	Build the next 8 chips of the stream (MSB first), the last byte is padded with LOW chips
+* Parameters: 	Byte to fill
+* Returns:		false when the stream is terminated and no chip is left
+/***********************************************************************************************************************/
+boolean RFM69OOK::ookFifoNextByte(byte &value)
+{
+	byte chips = 0;
+	value = 0;
+	while (chips < 8)
+	{
+		if (_fifoChips == 0)
+		{
+			if (!ookFifoNextRun()) 
+			{
+				_fifoEnd = true;
+				break;
+			}
+			continue;
+		}
+		value = (value << 1) | _fifoLevel;
+		_fifoChips--;
+		chips++;
+	}
+	if (chips == 0) return false;
+	value <<= 8 - chips;
+	return true;
+}
+/*************************************************** ookFifoNextRun ****************************************************
+* Function:  	Load the next run of identical chips: a frame duration or the delay between repeats
+* Parameters: 	None
+* Returns:		false when the last repeat is terminated
+/***********************************************************************************************************************/
+boolean RFM69OOK::ookFifoNextRun()
+{
+	const OokFrame &frame = *_txFrame;
+	unsigned int period = frame.periodusec;
+	if (_txIndex < frame.length)
+	{
+		_fifoLevel = (_txIndex & 1) ? 0 : 1;
+		_fifoChips = (frame.dur[_txIndex++] + period / 2) / period;
+		return true;
+	}
+	if (++_txRepeat >= frame.repeats) return false;
+	_txIndex = 0;
+	_fifoLevel = 0;												// Delay between repeats
+	_fifoChips = (frame.repDly * 1000UL + period / 2) / period;
+	return true;
+}
+/***********************************************************************************************************************/
+/**************************************************** ookEmitFrame *****************************************************
+* Function:  	Output an encoded frame to the RFM69 DIO2 pin through digitalWrite (see ookEmitFrameWith)
+* Parameters: 	Encoded frame
+/***********************************************************************************************************************/
+void RFM69OOK::ookEmitFrame(const OokFrame &frame)
+{
+	OokPin pin = { _ookDataPin };
+	ookEmitFrameWith(frame, pin);
+}
+/*************************************************** ookEmitCapture ****************************************************
+* Function:  	Output a raw capture to the RFM69 DIO2 pin through digitalWrite (see ookEmitWith)
+* Parameters: 	Raw capture located in program memory
+/***********************************************************************************************************************/
+void RFM69OOK::ookEmitCapture(const byte *capture)
+{
+	OokPin pin = { _ookDataPin };
+	OokCaptureSource source;
+	source.begin(capture);
+	ookEmitWith(source, pin);
+}
+/****************************************************** dryRun *********************************************************
+* Function:  	Output an encoded frame once on the data pin through digitalWrite, the RFM69 is not switched to 
+*				transmit so nothing is sent. Each edge time is compared to its nominal time in the frame.
+* Parameters: 	Encoded frame
+* Returns:		Edge errors relative to the first edge
+/***********************************************************************************************************************/
+OokEdgeErrors RFM69OOK::dryRun(const OokFrame &frame)
+{
+	OokPin pin = { _ookDataPin };
+	return ookDryRunWith(frame, pin);
+}
+/****************************************************** airtime ********************************************************
+* Function:  	Total air time of an encoded frame: all repeats and the delays between them
+* Parameters: 	Encoded frame
+* Returns:		Air time in us
+/***********************************************************************************************************************/
+unsigned long int RFM69OOK::airtime(const OokFrame &frame)
+{
+	unsigned long int frameTime = 0;
+	for (byte i = 0; i < frame.length; i++) frameTime += frame.dur[i];
+	if (frame.repeats == 0) return 0;
+	return frameTime * frame.repeats + (frame.repeats - 1) * frame.repDly * 1000UL;
+}
+/**************************************************** measureEdges *****************************************************
+* Function:  	Measure the edge output cost and the edge lateness against deadlines with digitalWrite
+* Parameters: 	None
+/***********************************************************************************************************************/
+OokEdgeStats RFM69OOK::measureEdges()
 {
-  int corrFactor = 150;                 			// Instruction delay correction factor
-  if(on !=0) {
-  	digitalWrite(_ookDataPin,HIGH);  		    // Skip the transition for the Start bit
-    delayMicroseconds (on-corrFactor);			// Adjusted for processing delay   
-  }              
-  digitalWrite(_ookDataPin,LOW);  
-  delayMicroseconds (off+corrFactor);       		// Adjusted for processing delay      
-  digitalWrite(_ookDataPin,HIGH);              		// Common part of any bit (1,3)
-  delayMicroseconds ((_periodusec)-corrFactor);                       
-  digitalWrite(_ookDataPin,LOW);
-  delayMicroseconds (corrFactor+(_periodusec*3));	// Adjusted for processing delay 
+	OokPin pin = { _ookDataPin };
+	return ookMeasureEdgesWith(pin);
+}
+/***************************************************** calibrate *******************************************************
+* Function:  	Measure the micros() resolution, the deadline polling cost and the edge output processing delay on
+*				the running board. The processing delay is used as lead time for the following edges.
+* Parameters: 	None
+* Returns:		Measured values and the worst-case edge error guaranteed for the current OOK pulse time
+*				(interrupt service routines running during the frame are not accounted for)
+/***********************************************************************************************************************/
+const OokCalibration &RFM69OOK::calibrate()
+{
+	const byte samples = 32;
+	unsigned long int start, now;
+	unsigned int resolution = 0xFFFF;
+	for (byte i = 0; i < 8; i++)						// Smallest micros() increment
+	{
+		start = micros();
+		while ((now = micros()) == start);
+		if (now - start < resolution) resolution = now - start;
+	}
+	start = micros();									// Cost of a deadline poll
+	for (byte i = 0; i < samples; i++) now = micros();
+	_calibration.pollUsec = (micros() - start + samples / 2) / samples;
+	_calibration.writeUsec = (measureEdges().edgeCostNs + 500) / 1000;	// Cost of an edge output
+	_calibration.resolutionUsec = resolution;
+	// An edge is late by at most one poll and one micros() step, plus the variation of the write processing delay
+	_calibration.edgeErrorUsec = resolution + _calibration.pollUsec + _calibration.writeUsec;
+	_calibration.edgeErrorPermil = (unsigned long) _calibration.edgeErrorUsec * 1000 / _periodusec;
+	_edgeLead = _calibration.writeUsec;
+	return _calibration;
 }
 /***********************************************************************************************************************/
 
-/*************************************************** printOokInfos *****************************************************
-* Function:  	Debugging information
+/*************************************************** setOokTimer *******************************************************
+* Function:  	Select the timer used for asynchronous sending
+* Parameters: 	Timer backend
+/***********************************************************************************************************************/
+void RFM69OOK::setOokTimer(OokTimer &timer)
+{
+	_timer = &timer;
+}
+/*************************************************** onSendDone ********************************************************
+* Function:  	Set the function called (from isBusy) when an asynchronous sending is terminated
+* Parameters: 	Callback function, NULL to disable
+/***********************************************************************************************************************/
+void RFM69OOK::onSendDone(OokDoneCallback callback)
+{
+	_doneCallback = callback;
+}
+/************************************************* beginSendKakuNew ****************************************************
+* Function:    Start sending message datagram according to the NEW Kaku protocol without blocking
+* Parameters:	See sendKakuNew
+* Returns:		false if an asynchronous sending is already in progress or no timer is available
+/***********************************************************************************************************************/
+boolean RFM69OOK::beginSendKakuNew(RFM69 &radio, unsigned long int addr, byte unit, boolean on, boolean group, byte dimLevel)
+{
+	if (!ookAsyncReady()) return false;
+	encodeKakuNew(ookAsyncFrame, addr, unit, on, group, dimLevel);
+	return beginSendFrame(radio, ookAsyncFrame);
+}
+/************************************************* beginSendKakuOld ****************************************************
+* Function:    Start sending message datagram according to the OLD Kaku protocol without blocking
+* Parameters:	See sendKakuOld
+* Returns:		false if an asynchronous sending is already in progress or no timer is available
+/***********************************************************************************************************************/
+boolean RFM69OOK::beginSendKakuOld(RFM69 &radio, char addr, byte unit, byte on)
+{
+	if (!ookAsyncReady()) return false;
+	encodeKakuOld(ookAsyncFrame, addr, unit, on);
+	return beginSendFrame(radio, ookAsyncFrame);
+}
+/************************************************ beginSendKakuCogex ***************************************************
+* Function:    Start sending message datagram according to the COGEX Kaku protocol without blocking
+* Parameters:	See sendKakuCogex
+* Returns:		false if an asynchronous sending is already in progress or no timer is available
+/***********************************************************************************************************************/
+boolean RFM69OOK::beginSendKakuCogex(RFM69 &radio, byte addr, byte unit, byte on)
+{
+	if (!ookAsyncReady()) return false;
+	encodeKakuCogex(ookAsyncFrame, addr, unit, on);
+	return beginSendFrame(radio, ookAsyncFrame);
+}
+/************************************************** beginSendFrame *****************************************************
+* Function:    	Start sending an encoded frame without blocking. The edges are output from the timer compare 
+*				interrupt, the RFM69 registers are restored by isBusy once the last repeat is sent.
+* Parameters:	
+*				RFM69 radio instance
+*				Encoded frame, must stay valid until the sending is terminated
+* Returns:		false if an asynchronous sending is already in progress or no timer is available
+* Note:			The channel is sampled once here and then by isBusy, the sending starts once the channel access is 
+*				granted, at once when channelAccess has just returned a clear channel. It never waits for the channel.
+/***********************************************************************************************************************/
+boolean RFM69OOK::beginSendFrame(RFM69 &radio, const OokFrame &frame)
+{
+	if (!ookAsyncReady()) return false;									// The timer is in use
+	if (_txBackend == OOK_BACKEND_FIFO)
+	{
+		if (frame.periodusec > OOK_FIFO_MAX_PERIOD) return false;		// Bit rate out of range
+	}
+	else
+	{
+		if (_timer == NULL) _timer = ookDefaultTimer();
+		if (_timer == NULL) return false;								// No timer for this platform
+	}
+	_txRadio = &radio;
+	_txFrame = &frame;
+	_asyncOwner = this;
+	if (!(_channelGranted && millis() - _grantTime < OOK_GRANT_MS))
+	{
+		_txState = OOK_TX_ACCESS;										// Channel sampled by isBusy
+		isBusy();														// A clear channel starts the sending now
+		return true;
+	}
+	return ookAsyncStart();												// Granted, ookPreSend does not wait
+}
+/*************************************************** ookAsyncStart *****************************************************
+* Function:    	Prepare the RFM69 and output the first edge of the asynchronous sending
+* Parameters:	None
+* Returns:		false if the channel access is not granted
+/***********************************************************************************************************************/
+boolean RFM69OOK::ookAsyncStart()
+{
+	RFM69 &radio = *_txRadio;
+	const OokFrame &frame = *_txFrame;
+	if (!ookPreSend (radio))											// Prepare RFM69 registers and media
+	{
+		_txState = OOK_TX_IDLE;
+		_asyncOwner = NULL;
+		return false;
+	}
+	ookTraceSend(frame.protocol, frame.periodusec, frame.repeats, frame.repDly, frame.length);
+#if OOK_STATS
+	_txStart = micros();
+	_txEnd = _txStart;
+#endif
+	_txIndex = 0;
+	_txRepeat = 0;
+	if (frame.repeats == 0)
+	{
+		_txState = OOK_TX_DONE;
+		return true;
+	}
+	_txState = OOK_TX_RUNNING;
+	if (_fifoActive)													// Chips are refilled by isBusy
+	{
+		ookFifoStart(radio, frame);
+		return true;
+	}
+	_timer->begin(ookTimerIsr);
+	ookTimerTick();														// Output the first edge now
+	return true;
+}
+/****************************************************** isBusy *********************************************************
+* Function:    	Check for an asynchronous sending in progress. When the last repeat is sent, the RFM69 registers are
+*				restored, the timer is released and the send done function is called. With the FIFO backend, the FIFO is refilled here
+*				so isBusy must be called at least every OOK_FIFO_THRESHOLD * 8 OOK pulse times.
+*				While waiting for a clear channel, the channel is sampled here: a deferred sending starts a new 
+*				channel access, a dropped sending is terminated and the send done function is called.
+* Parameters:	None
+* Returns:		true while the asynchronous sending is in progress
+/***********************************************************************************************************************/
+boolean RFM69OOK::isBusy()
+{
+	if (_txState == OOK_TX_ACCESS)
+	{
+		byte result = channelAccess(*_txRadio);
+		if (result == OOK_CHANNEL_DROPPED)
+		{
+			_txState = OOK_TX_IDLE;
+			_asyncOwner = NULL;											// The callback may start a new sending
+			if (_doneCallback) _doneCallback(*this);
+			return false;
+		}
+		if (result != OOK_CHANNEL_READY && result != OOK_CHANNEL_FORCED) return true;
+		ookAsyncStart();
+	}
+	if (_txState == OOK_TX_RUNNING && _fifoActive && !ookFifoService(*_txRadio))
+	{
+#if OOK_STATS
+		_txEnd = micros();
+#endif
+		_txState = OOK_TX_DONE;
+	}
+	if (_txState == OOK_TX_DONE)
+	{
+		_txState = OOK_TX_IDLE;
+#if OOK_STATS
+		ookStatsFrame(_txFrame->protocol, _txFrame->repeats, _txEnd - _txStart);
+		_emitCarrierUsec += ookFrameCarrier(*_txFrame);
+#endif
+		ookPostSend (*_txRadio);										// Restore RFM69 registers after OOK sending
+		_asyncOwner = NULL;
+		if (_doneCallback) _doneCallback(*this);
+	}
+	return _txState == OOK_TX_RUNNING;
+}
+/*************************************************** ookAsyncReady *****************************************************
+* Function:  	Check that no asynchronous sending is using the timer and the shared frame
 * Parameters: 	None
 /***********************************************************************************************************************/
- void RFM69OOK::printOokInfos (unsigned long int addr, unsigned long int unit, boolean on, boolean group, byte dimLevel,int cmd)
+boolean RFM69OOK::ookAsyncReady()
 {
-    	Serial.print ("RF69OOK version: "), Serial.print(MAJOR), Serial.print("."), Serial.println (MINOR);
-    	Serial.print ("House Code: ");
-    	if (addr > 64 & addr <81) Serial.print((char) addr);		// Convert address to ASCII for old Kaku address 
-    	else Serial.print(addr);
-    	Serial.print (" Set Logical Unit: "),
-        Serial.print (unit), Serial.print (" to: "), Serial.println(on); 
-        if(group) Serial.print("Group: "), Serial.print(group);
-        if(dimLevel) Serial.print(" DIM level: "), Serial.println (dimLevel);
-        Serial.print("Data pin: "), Serial.print (_ookDataPin); Serial.print ("; Period: " ), 
-        Serial.print( _periodusec), Serial.print ("; Repeated: "), Serial.print (_repeats), Serial.print ("; Delay: "),
-        Serial.println (_repDly);
- 	    Serial.print ("Command datagram: "), Serial.println (cmd,BIN), Serial.println ();
+	return _asyncOwner == NULL || _asyncOwner->_txState == OOK_TX_IDLE;
+}
+/*************************************************** ookTimerIsr *******************************************************
+* Function:  	Timer compare event handler, forwarded to the instance owning the timer
+* Parameters: 	None
+/***********************************************************************************************************************/
+void OOK_ISR_ATTR RFM69OOK::ookTimerIsr()
+{
+	if (_asyncOwner != NULL) _asyncOwner->ookTimerTick();
+}
+/*************************************************** ookTimerTick ******************************************************
+* Function:  	Output the next edge of the frame and schedule the following one, the gap between repeats is 
+*				scheduled at the end of a frame. Called from the timer compare interrupt.
+* Parameters: 	None
+/***********************************************************************************************************************/
+void OOK_ISR_ATTR RFM69OOK::ookTimerTick()
+{
+	if (_txState != OOK_TX_RUNNING) return;
+	const OokFrame &frame = *_txFrame;
+	while (_txIndex < frame.length)
+	{
+		unsigned int dur = frame.dur[_txIndex];
+		byte level = (_txIndex & 1) ? LOW : HIGH;
+		_txIndex++;
+		if (dur == 0) continue;											// Skipped for the Start bit of Old Kaku and Cogex
+		digitalWrite(_ookDataPin, level);
+		unsigned int trim = OOK_HIGH_TRIM(frame.dur[(_txIndex - 1) & ~1]);	// RFM69 OOK output compensation
+		_timer->start(level == HIGH ? dur - trim : dur + trim);
+		return;
+	}
+	_txIndex = 0;														// End of frame
+	if (++_txRepeat < frame.repeats)
+	{
+		_timer->start(frame.repDly * 1000UL);							// Wait some delay between retries
+		return;
+	}
+	_timer->stop();
+#if OOK_STATS
+	_txEnd = micros();
+#endif
+	_txState = OOK_TX_DONE;												// Registers are restored by isBusy
+}
+/***********************************************************************************************************************/
+
+/*************************************************** enqueueKakuNew ****************************************************
+* Function:  	Queue a NEW Kaku command for a later batched sending (see flush), the current timing parameters
+*				are recorded with the command
+* Parameters: 	See sendKakuNew
+* Returns:		false if the queue is full
+/***********************************************************************************************************************/
+boolean RFM69OOK::enqueueKakuNew(unsigned long int addr, byte unit, boolean on, boolean group, byte dimLevel)
+{
+	OokCommand *command = ookQueueAdd(OOK_KAKU_NEW);
+	if (command == NULL) return false;
+	command->addr = addr;
+	command->unit = unit;
+	command->on = on;
+	command->group = group;
+	command->dimLevel = dimLevel;
+	return true;
+}
+/*************************************************** enqueueKakuOld ****************************************************
+* Function:  	Queue an OLD Kaku command for a later batched sending (see flush)
+* Parameters: 	See sendKakuOld
+* Returns:		false if the queue is full
+/***********************************************************************************************************************/
+boolean RFM69OOK::enqueueKakuOld(char addr, byte unit, byte on)
+{
+	OokCommand *command = ookQueueAdd(OOK_KAKU_OLD);
+	if (command == NULL) return false;
+	command->addr = addr;
+	command->unit = unit;
+	command->on = on;
+	return true;
+}
+/************************************************** enqueueKakuCogex ***************************************************
+* Function:  	Queue a COGEX Kaku command for a later batched sending (see flush)
+* Parameters: 	See sendKakuCogex
+* Returns:		false if the queue is full
+/***********************************************************************************************************************/
+boolean RFM69OOK::enqueueKakuCogex(byte addr, byte unit, byte on)
+{
+	OokCommand *command = ookQueueAdd(OOK_KAKU_COGEX);
+	if (command == NULL) return false;
+	command->addr = addr;
+	command->unit = unit;
+	command->on = on;
+	return true;
+}
+/****************************************************** queued *********************************************************
+* Function:  	Number of queued commands
+* Parameters: 	None
+/***********************************************************************************************************************/
+byte RFM69OOK::queued()
+{
+	return _queueLength;
+}
+/**************************************************** clearQueue *******************************************************
+* Function:  	Drop all queued commands
+* Parameters: 	None
+/***********************************************************************************************************************/
+void RFM69OOK::clearQueue()
+{
+	_queueLength = 0;
+}
+/******************************************************* flush *********************************************************
+* Function:  	Send all queued commands back to back. The RFM69 registers are saved and switched to OOK once before 
+*				the first frame and restored once after the last one. Each command keeps the timing parameters 
+*				recorded when it was queued, the repeat delay of a command separates it from the next one.
+* Parameters: 	RFM69 radio instance
+/***********************************************************************************************************************/
+void RFM69OOK::flush(RFM69 &radio)
+{
+	if (_queueLength == 0) return;
+	OokFrame frame;
+	unsigned int periodusec = _periodusec;						// Save the current timing parameters
+	byte repeats = _repeats;
+	byte repDly = _repDly;
+	unsigned long int reads = _regReads;
+	unsigned long int writes = _regWrites;
+	if (!ookPreSend (radio))									// Prepare RFM69 registers once for the whole batch
+	{
+		memset(&_batchStats, 0, sizeof(_batchStats));
+		if (_accessState == OOK_CHANNEL_DROPPED) _queueLength = 0;	// Deferred commands stay queued
+		return;
+	}
+	unsigned int cycleReads = _regReads - reads;				// Accesses of the pre and post sending procedures
+	unsigned int cycleWrites = _regWrites - writes;
+	_batchStats.commands = _queueLength;
+	_batchStats.frames = 0;
+	for (byte i = 0; i < _queueLength; i++)
+	{
+		OokCommand &command = _queue[i];
+		_periodusec = command.periodusec;						// Encode with the command timing parameters
+		_repeats = command.repeats;
+		_repDly = command.repDly;
+		switch (command.protocol)
+		{
+			case OOK_KAKU_NEW:
+				encodeKakuNew(frame, command.addr, command.unit, command.on, command.group, command.dimLevel);
+				break;
+			case OOK_KAKU_OLD:
+				encodeKakuOld(frame, (char) command.addr, command.unit, command.on);
+				break;
+			default:
+				encodeKakuCogex(frame, (byte) command.addr, command.unit, command.on);
+				break;
+		}
+		ookSendRepeats(radio, frame);
+		_batchStats.frames += frame.repeats;
+	}
+	unsigned long int postReads = _regReads;
+	unsigned long int postWrites = _regWrites;
+	ookPostSend (radio);										// Restore RFM69 registers once
+	cycleReads += _regReads - postReads;
+	cycleWrites += _regWrites - postWrites;
+	_periodusec = periodusec;									// Restore the current timing parameters
+	_repeats = repeats;
+	_repDly = repDly;
+	_batchStats.regReads = _regReads - reads;
+	_batchStats.regWrites = _regWrites - writes;
+	// Register accesses saved compared to sending each command on its own: one pre and post sending cycle per 
+	// command instead of one for the batch. Frame accesses (FIFO refills, standby gaps...) are the same both ways.
+	_batchStats.regReadsSaved = (_queueLength - 1) * cycleReads;
+	_batchStats.regWritesSaved = (_queueLength - 1) * cycleWrites;
+	_queueLength = 0;
+}
+/*************************************************** getBatchStats *****************************************************
+* Function:  	Statistics of the last flush
+* Parameters: 	None
+/***********************************************************************************************************************/
+const OokBatchStats &RFM69OOK::getBatchStats()
+{
+	return _batchStats;
+}
+/**************************************************** ookQueueAdd ******************************************************
+* Function:  	Reserve a queue entry and record the protocol and current timing parameters
+* Parameters: 	Protocol of the command
+* Returns:		Queue entry, NULL if the queue is full
+/***********************************************************************************************************************/
+OokCommand *RFM69OOK::ookQueueAdd(byte protocol)
+{
+	if (_queueLength >= OOK_QUEUE_SIZE) return NULL;
+	OokCommand *command = &_queue[_queueLength++];
+	command->protocol = protocol;
+	command->group = false;
+	command->dimLevel = 0;
+	command->periodusec = _periodusec;
+	command->repeats = _repeats;
+	command->repDly = _repDly;
+	return command;
+}
+/***********************************************************************************************************************/
+
+/*************************************************** OokTimerAvr1 ******************************************************
+* Function:  	AVR Timer1 backend, compare A interrupt in normal mode with a prescaler of 8. Compare values are
+*				advanced from the previous one so that timing errors do not accumulate. Intervals longer than
+*				a compare period are split in several compare events.
+/***********************************************************************************************************************/
+#if defined(__AVR__)
+#define OOK_TIMER1_CHUNK	0x8000UL									// Longest interval scheduled at once (ticks)
+void (*volatile OokTimerAvr1::isr)(void) = NULL;
+volatile unsigned long OokTimerAvr1::pending = 0;
+
+void OokTimerAvr1::begin(void (*function)(void))
+{
+	uint8_t sreg = SREG;
+	cli();
+	isr = function;
+	pending = 0;
+	TCCR1A = 0;															// Normal mode
+	TCCR1B = _BV(CS11);													// Prescaler 8
+	OCR1A = TCNT1;														// Time reference
+	TIMSK1 &= ~_BV(OCIE1A);
+	SREG = sreg;
+}
+void OokTimerAvr1::start(unsigned long usec)
+{
+	unsigned long ticks = usec * (F_CPU / 1000000UL) / 8;
+	if (ticks > OOK_TIMER1_CHUNK)
+	{
+		pending = ticks - OOK_TIMER1_CHUNK;
+		ticks = OOK_TIMER1_CHUNK;
+	}
+	else pending = 0;
+	OCR1A += (uint16_t) ticks;
+	TIFR1 = _BV(OCF1A);													// Clear a pending compare flag
+	TIMSK1 |= _BV(OCIE1A);
+}
+void OokTimerAvr1::stop()
+{
+	TIMSK1 &= ~_BV(OCIE1A);
+}
+// Declared weak so that a sketch using Timer1 for another purpose still links
+ISR(TIMER1_COMPA_vect, __attribute__((weak)))
+{
+	if (OokTimerAvr1::pending != 0)										// Long interval not yet elapsed
+	{
+		unsigned long ticks = OokTimerAvr1::pending;
+		if (ticks > OOK_TIMER1_CHUNK) ticks = OOK_TIMER1_CHUNK;
+		OokTimerAvr1::pending -= ticks;
+		OCR1A += (uint16_t) ticks;
+		return;
+	}
+	TIMSK1 &= ~_BV(OCIE1A);												// Single shot, re-enabled by start()
+	if (OokTimerAvr1::isr) OokTimerAvr1::isr();
+}
+/************************************************** OokTimerEsp8266 ****************************************************
+* Function:  	ESP8266 timer1 backend in single shot mode with a divider of 16 (5 ticks per us)
+/***********************************************************************************************************************/
+#elif defined(ESP8266)
+void OokTimerEsp8266::begin(void (*function)(void))
+{
+	timer1_isr_init();
+	timer1_attachInterrupt(function);
+}
+void OOK_ISR_ATTR OokTimerEsp8266::start(unsigned long usec)
+{
+	timer1_enable(TIM_DIV16, TIM_EDGE, TIM_SINGLE);
+	timer1_write(usec * 5);
+}
+void OOK_ISR_ATTR OokTimerEsp8266::stop()
+{
+	timer1_disable();
+}
+#endif
+/************************************************** OokVirtualTimer ****************************************************
+* Function:  	Virtual clock backend, compare events are fired by advance(). Intended to drive the asynchronous
+*				transmitter from a host simulation.
+/***********************************************************************************************************************/
+OokVirtualTimer::OokVirtualTimer()
+{
+	_isr = NULL;
+	_now = 0;
+	_deadline = 0;
+	_armed = false;
+}
+void OokVirtualTimer::begin(void (*function)(void))
+{
+	_isr = function;
+	_deadline = _now;
+	_armed = false;
+}
+void OokVirtualTimer::start(unsigned long usec)
+{
+	_deadline += usec;
+	_armed = true;
+}
+void OokVirtualTimer::stop()
+{
+	_armed = false;
+}
+void OokVirtualTimer::advance(unsigned long usec)
+{
+	unsigned long target = _now + usec;
+	while (_armed && (long)(target - _deadline) >= 0)
+	{
+		_now = _deadline;
+		_armed = false;
+		if (_isr) _isr();
+	}
+	_now = target;
+}
+unsigned long OokVirtualTimer::now()
+{
+	return _now;
 }
 /***********************************************************************************************************************/
 
 /***************************************************** ookPreSend ******************************************************
 * Function:  	Save and configure RFM registers for OOK tramission and wait for clear media before sending a OOK frame
 * Parameters: 	RFM69 radio instance
+* Returns:		false if the sending is dropped or deferred by the channel access policy, registers are unchanged
 /***********************************************************************************************************************/
- void RFM69OOK::ookPreSend (RFM69 &radio)
+boolean RFM69OOK::ookPreSend (RFM69 &radio)
 {
-    radio.writeReg(REG_PACKETCONFIG2, (radio.readReg(REG_PACKETCONFIG2) & 0xFB) | RF_PACKET2_RXRESTART); // avoid RX deadlocks
-    uint32_t now = millis();
-    while (!radio.canSend() && millis() - now < RF69_CSMA_LIMIT_MS) radio.receiveDone();
-	_mode = radio.readReg(REG_OPMODE);			// Record the previous Operation mode
-   	_modulation = radio.readReg(REG_DATAMODUL); // Record the previous Modulation Mode
-  	_bitRateMsb = radio.readReg(REG_BITRATEMSB);// Record the previous value of the BitRate MSB
-   	_bitRateLsb = radio.readReg(REG_BITRATELSB);// Record the previous value of the BitRate LSB
+    ookWriteReg(radio, REG_PACKETCONFIG2, (ookReadReg(radio, REG_PACKETCONFIG2) & 0xFB) | RF_PACKET2_RXRESTART); // avoid RX deadlocks
+	if (!ookWaitChannel(radio)) return false;
+    _regValid &= ~_BV(OOK_SLOT_OPMODE);				// The RFM69 library may have changed the Operation mode
+	_mode = ookReadReg(radio, REG_OPMODE);			// Record the previous Operation mode
+   	_modulation = ookReadReg(radio, REG_DATAMODUL); // Record the previous Modulation Mode
+  	_bitRateMsb = ookReadReg(radio, REG_BITRATEMSB);// Record the previous value of the BitRate MSB
+   	_bitRateLsb = ookReadReg(radio, REG_BITRATELSB);// Record the previous value of the BitRate LSB
+	_fifoActive = (_txBackend == OOK_BACKEND_FIFO);
+#if OOK_STATS
+	memset(&_energy, 0, sizeof(_energy));							// New energy report
+	_emitCarrierUsec = 0;
+	_txModeStart = micros();
+#endif
+	if (_fifoActive)
+	{
+		// Record the packet engine settings and set it for a raw chip stream: OOK packet mode without preamble,
+		// sync word, CRC, address filtering, encryption and with an unlimited length
+		for (byte i = 0; i < sizeof(ookFifoRegs); i++) _fifoSaved[i] = ookReadReg(radio, ookFifoRegs[i]);
+		ookWriteReg(radio, REG_OPMODE, RF_OPMODE_STANDBY);
+		ookWriteReg(radio, REG_DATAMODUL, RF_DATAMODUL_DATAMODE_PACKET|RF_DATAMODUL_MODULATIONTYPE_OOK);
+		ookWriteReg(radio, REG_PREAMBLEMSB, 0);
+		ookWriteReg(radio, REG_PREAMBLELSB, 0);
+		ookWriteReg(radio, REG_SYNCCONFIG, RF_SYNC_OFF);
+		ookWriteReg(radio, REG_PACKETCONFIG1, RF_PACKET1_FORMAT_FIXED|RF_PACKET1_DCFREE_OFF|RF_PACKET1_CRC_OFF|
+			RF_PACKET1_ADRSFILTERING_OFF);
+		ookWriteReg(radio, REG_PAYLOADLENGTH, 0);
+		ookWriteReg(radio, REG_FIFOTHRESH, RF_FIFOTHRESH_TXSTART_FIFONOTEMPTY|OOK_FIFO_THRESHOLD);
+		ookWriteReg(radio, REG_PACKETCONFIG2, _fifoSaved[OOK_FIFO_SAVED_PACKETCONFIG2] & ~RF_PACKET2_AES_ON);
+		return true;											// Transmission is started by ookFifoStart
+	}
    	// Set Modulation to OOK continuous mode without synchronisation
-   	radio.writeReg(REG_DATAMODUL, RF_DATAMODUL_DATAMODE_CONTINUOUSNOBSYNC|RF_DATAMODUL_MODULATIONTYPE_OOK);	
+   	ookWriteReg(radio, REG_DATAMODUL, RF_DATAMODUL_DATAMODE_CONTINUOUSNOBSYNC|RF_DATAMODUL_MODULATIONTYPE_OOK);	
    	// Set the Operation mode to transmit
-	radio.writeReg(REG_OPMODE, RF_OPMODE_TRANSMITTER);
+	ookWriteReg(radio, REG_OPMODE, RF_OPMODE_TRANSMITTER);
+	_blindStart = millis();										// No FSK reception from now on
+	return true;
 }
 /***********************************************************************************************************************/
 void RFM69OOK::ookPostSend(RFM69 &radio)
  { 
-   	radio.writeReg(REG_OPMODE,_mode);                    			// Restore previous OPMODE
-  	radio.writeReg(REG_DATAMODUL,_modulation);           			// Restore previous MODULATION    
-  	radio.writeReg(REG_BITRATEMSB,_bitRateMsb);			            // Restore previous BIT RATE value
-  	radio.writeReg(REG_BITRATELSB,_bitRateLsb);			            // Restore previous BIT RATE value 
- }
\ No newline at end of file
+	if (_fifoActive)
+	{
+		ookWriteReg(radio, REG_OPMODE, RF_OPMODE_STANDBY);		// Stop the packet engine before restoring it
+		for (byte i = 0; i < sizeof(ookFifoRegs); i++) ookWriteReg(radio, ookFifoRegs[i], _fifoSaved[i]);
+		_fifoActive = false;
+	}
+#if OOK_STATS
+	ookEnergyEnd();
+#endif
+   	ookWriteReg(radio, REG_OPMODE,_mode);                    		// Restore previous OPMODE
+  	ookWriteReg(radio, REG_DATAMODUL,_modulation);           		// Restore previous MODULATION    
+  	ookWriteReg(radio, REG_BITRATEMSB,_bitRateMsb);			        // Restore previous BIT RATE value
+  	ookWriteReg(radio, REG_BITRATELSB,_bitRateLsb);			        // Restore previous BIT RATE value 
+#if OOK_STATS
+	if (_coexBlindMs && millis() - _blindStart > _stats.maxBlindMs) _stats.maxBlindMs = millis() - _blindStart;
+#endif
+	if (_fskListen)
+	{
+		ookWriteReg(radio, REG_OPMODE, RF_OPMODE_RECEIVER);			// The RFM69 library may expect the receive mode
+		_fskListen = false;
+	}
+ }
+/**************************************************** setRegCache ******************************************************
+* Function:  	Enable or disable the shadow cache of the RFM69 registers used by the pre and post sending procedures.
+*				With the cache enabled, reads of a known register value and writes not changing it are skipped.
+*				invalidateRegCache must be called when the application changes these registers directly through
+*				the RFM69 instance (initialize, writeReg of REG_DATAMODUL, REG_BITRATEMSB/LSB or REG_PACKETCONFIG2).
+* Parameters: 	true to enable the cache
+/***********************************************************************************************************************/
+void RFM69OOK::setRegCache(boolean enable)
+{
+	_regCacheOn = enable;
+	_regValid = 0;
+}
+/************************************************* invalidateRegCache **************************************************
+* Function:  	Forget all cached register values, the next accesses are done on the RFM69
+* Parameters: 	None
+/***********************************************************************************************************************/
+void RFM69OOK::invalidateRegCache()
+{
+	_regValid = 0;
+}
+/***************************************************** ookRegSlot ******************************************************
+* Function:  	Shadow cache slot of a register
+* Parameters: 	Register address
+* Returns:		Slot index, OOK_SLOT_NONE for a register not cached
+/***********************************************************************************************************************/
+static byte ookRegSlot(byte addr)
+{
+	switch (addr)
+	{
+		case REG_PACKETCONFIG2:	return OOK_SLOT_PACKETCONFIG2;
+		case REG_OPMODE:		return OOK_SLOT_OPMODE;
+		case REG_DATAMODUL:		return OOK_SLOT_DATAMODUL;
+		case REG_BITRATEMSB:	return OOK_SLOT_BITRATEMSB;
+		case REG_BITRATELSB:	return OOK_SLOT_BITRATELSB;
+		default:				return OOK_SLOT_NONE;
+	}
+}
+/***************************************************** ookReadReg ******************************************************
+* Function:  	Read a RFM69 register, from the shadow cache when its value is known. RFM69 accesses are counted.
+* Parameters: 	
+*				RFM69 radio instance
+*				Register address
+/***********************************************************************************************************************/
+byte RFM69OOK::ookReadReg(RFM69 &radio, byte addr)
+{
+	byte slot = _regCacheOn ? ookRegSlot(addr) : OOK_SLOT_NONE;
+	if (slot != OOK_SLOT_NONE && (_regValid & _BV(slot))) return _regShadow[slot];
+	_regReads++;
+	byte value = radio.readReg(addr);
+	if (slot != OOK_SLOT_NONE)
+	{
+		_regShadow[slot] = value;
+		_regValid |= _BV(slot);
+	}
+	return value;
+}
+/**************************************************** ookWriteReg ******************************************************
+* Function:  	Write a RFM69 register, skipped when the shadow cache shows the value is unchanged. The RX restart
+*				bit of REG_PACKETCONFIG2 is a command, such a write is always done. RFM69 accesses are counted.
+* Parameters: 	
+*				RFM69 radio instance
+*				Register address
+*				Register value
+/***********************************************************************************************************************/
+void RFM69OOK::ookWriteReg(RFM69 &radio, byte addr, byte value)
+{
+	byte slot = _regCacheOn ? ookRegSlot(addr) : OOK_SLOT_NONE;
+	if (slot == OOK_SLOT_PACKETCONFIG2 && (value & RF_PACKET2_RXRESTART))
+	{
+		_regShadow[slot] = value & ~RF_PACKET2_RXRESTART;	// The restart bit always reads 0
+		_regValid |= _BV(slot);
+	}
+	else if (slot != OOK_SLOT_NONE)
+	{
+		if ((_regValid & _BV(slot)) && _regShadow[slot] == value) return;
+		_regShadow[slot] = value;
+		_regValid |= _BV(slot);
+	}
+	_regWrites++;
+	radio.writeReg(addr, value);
+}
+/***********************************************************************************************************************/
+
+/*************************************************** RFM69OOKMulti *****************************************************
+* Function:  	Define a RFM69OOKMulti Class without channels
+* Parameters:	None
+/***********************************************************************************************************************/
+RFM69OOKMulti::RFM69OOKMulti()
+{
+	_count = 0;
+}
+/******************************************************** add **********************************************************
+* Function:  	Add a frame to send with a RFM69OOK instance (its data pin) and its RFM69
+* Parameters: 	
+*				RFM69OOK instance, not already added and using the DIO2 backend
+*				RFM69 radio instance
+*				Encoded frame, must stay valid until send
+* Returns:		false if no channel is left or the RFM69OOK instance cannot be used
+/***********************************************************************************************************************/
+boolean RFM69OOKMulti::add(RFM69OOK &ook, RFM69 &radio, const OokFrame &frame)
+{
+	if (_count >= OOK_MULTI_CHANNELS || ook._txBackend != OOK_BACKEND_DIO2) return false;
+	for (byte i = 0; i < _count; i++) if (_channels[i].ook == &ook) return false;
+	OokChannel &channel = _channels[_count++];
+	channel.ook = &ook;
+	channel.radio = &radio;
+	channel.frame = &frame;
+	return true;
+}
+/****************************************************** channels *******************************************************
+* Function:  	Number of added channels
+* Parameters: 	None
+/***********************************************************************************************************************/
+byte RFM69OOKMulti::channels()
+{
+	return _count;
+}
+/******************************************************** clear ********************************************************
+* Function:  	Remove all channels
+* Parameters: 	None
+/***********************************************************************************************************************/
+void RFM69OOKMulti::clear()
+{
+	_count = 0;
+}
+/******************************************************** send *********************************************************
+* Function:  	Prepare all RFM69 (ookPreSend), output the edges of all frames and their repeats in time order, then 
+*				restore all RFM69 (ookPostSend). Each channel keeps the edge timing of ookEmitFrameWith: edges against 
+*				absolute deadlines written _edgeLead us ahead, HIGH levels OOK_HIGH_TRIM us shorter, repDly ms after 
+*				each repeat. Edges of different channels falling together are output one after the other. A channel 
+*				dropped or deferred by its channel access (setChannelAccess) is not sent.
+* Parameters: 	None
+/***********************************************************************************************************************/
+void RFM69OOKMulti::send()
+{
+	byte active = 0;
+	for (byte i = 0; i < _count; i++) _channels[i].granted = _channels[i].ook->ookPreSend(*_channels[i].radio);
+	unsigned long int start = micros();
+	unsigned long int end = start;
+	for (byte i = 0; i < _count; i++)
+	{
+		OokChannel &channel = _channels[i];
+		channel.pos = start;
+		channel.index = 0;
+		channel.repeat = 0;
+		channel.low = (channel.frame->length == 0 || channel.frame->dur[0] == 0);	// No HIGH edge
+		channel.done = (!channel.granted || channel.frame->repeats == 0 || channel.frame->length == 0);
+		if (!channel.done) active++;
+		if (channel.granted) channel.ook->ookTraceSend(channel.frame->protocol, channel.frame->periodusec, 
+			channel.frame->repeats, channel.frame->repDly, channel.frame->length);
+	}
+	while (active)
+	{
+		OokChannel *next = NULL;
+		unsigned long int deadline = 0;
+		for (byte i = 0; i < _count; i++)						// Earliest next edge of all channels
+		{
+			OokChannel &channel = _channels[i];
+			if (channel.done) continue;
+			unsigned long int time = ookMultiEdgeTime(channel) - channel.ook->_edgeLead;
+			if (next == NULL || (long)(time - deadline) < 0)
+			{
+				next = &channel;
+				deadline = time;
+			}
+		}
+		while ((long)(micros() - deadline) < 0);
+		digitalWrite(next->ook->_ookDataPin, next->low ? LOW : HIGH);
+		ookMultiAdvance(*next);
+		if (next->done)
+		{
+			active--;
+			if ((long)(next->pos - end) > 0) end = next->pos;
+		}
+	}
+	while ((long)(micros() - end) < 0);							// Hold the last LOW level and repeat delay
+	for (byte i = 0; i < _count; i++)
+	{
+		OokChannel &channel = _channels[i];
+		if (!channel.granted) continue;							// Dropped or deferred by its channel access
+#if OOK_STATS
+		channel.ook->_emitCarrierUsec += RFM69OOK::ookFrameCarrier(*channel.frame);	// Before the energy report
+#endif
+		channel.ook->ookPostSend(*channel.radio);
+#if OOK_STATS
+		channel.ook->ookStatsFrame(channel.frame->protocol, channel.frame->repeats, channel.pos - start);
+#endif
+	}
+	_count = 0;
+}
+/************************************************** ookMultiEdgeTime ***************************************************
+* Function:  	Nominal time of the next edge of a channel
+* Parameters: 	Channel
+/***********************************************************************************************************************/
+unsigned long int RFM69OOKMulti::ookMultiEdgeTime(const OokChannel &channel)
+{
+	if (!channel.low) return channel.pos;
+	unsigned int high = channel.frame->dur[channel.index];
+	return channel.pos + high - OOK_HIGH_TRIM(high);
+}
+/************************************************** ookMultiAdvance ****************************************************
+* Function:  	Move a channel to its next edge: the LOW edge of the pulse, else the next pulse, else the next 
+*				repeat after the repeat delay. A 0 HIGH duration has no HIGH edge.
+* Parameters: 	Channel
+/***********************************************************************************************************************/
+void RFM69OOKMulti::ookMultiAdvance(OokChannel &channel)
+{
+	const OokFrame &frame = *channel.frame;
+	if (!channel.low)
+	{
+		channel.low = true;
+		return;
+	}
+	channel.pos += frame.dur[channel.index] + frame.dur[channel.index + 1];
+	channel.index += 2;
+	if (channel.index >= frame.length)
+	{
+		channel.index = 0;
+		channel.pos += frame.repDly * 1000UL;
+		if (++channel.repeat >= frame.repeats)
+		{
+			channel.done = true;
+			return;
+		}
+	}
+	channel.low = (frame.dur[channel.index] == 0);
+}
+/***********************************************************************************************************************/
+
+/*************************************************** RFM69OOKScene *****************************************************
+* Function:  	Define a RFM69OOKScene Class without devices and a refresh TTL of OOK_SCENE_TTL
+* Parameters:	None
+/***********************************************************************************************************************/
+RFM69OOKScene::RFM69OOKScene()
+{
+	_count = 0;
+	_ttl = OOK_SCENE_TTL;
+	memset(&_plan, 0, sizeof(_plan));
+}
+/****************************************************** addDevice ******************************************************
+* Function:  	Declare a device with an unknown state
+* Parameters: 	
+*				Protocol (OOK_KAKU_...)
+*				House address
+*				Remote switch unit address
+* Returns:		false if no device entry is left
+/***********************************************************************************************************************/
+boolean RFM69OOKScene::addDevice(byte protocol, unsigned long int addr, byte unit)
+{
+	if (ookSceneFind(protocol, addr, unit) != NULL) return true;
+	if (_count >= OOK_SCENE_DEVICES) return false;
+	OokDevice &device = _devices[_count++];
+	device.protocol = protocol;
+	device.addr = addr;
+	device.unit = unit;
+	device.known = false;
+	device.target = false;
+	return true;
+}
+/********************************************************* set *********************************************************
+* Function:  	Request a device state in the current scene
+* Parameters: 	
+*				Protocol (OOK_KAKU_...)
+*				House address
+*				Remote switch unit address
+*				Remote switch state level
+*				Remote switch dim level, 0 for none (New only)
+* Returns:		false if the device is unknown and no device entry is left
+/***********************************************************************************************************************/
+boolean RFM69OOKScene::set(byte protocol, unsigned long int addr, byte unit, boolean on, byte dimLevel)
+{
+	if (!addDevice(protocol, addr, unit)) return false;
+	OokDevice *device = ookSceneFind(protocol, addr, unit);
+	device->target = true;
+	device->targetOn = on;
+	device->targetDim = (on && protocol == OOK_KAKU_NEW) ? dimLevel : 0;	// As sent by encodeKakuNew
+	return true;
+}
+/***************************************************** clearScene ******************************************************
+* Function:  	Drop the requested states of the current scene
+* Parameters: 	None
+/***********************************************************************************************************************/
+void RFM69OOKScene::clearScene()
+{
+	for (byte i = 0; i < _count; i++) _devices[i].target = false;
+}
+/*************************************************** setRefreshTtl *****************************************************
+* Function:  	Time a commanded state is trusted: a device requested in the same state within this time is skipped.
+*				0 sends every requested device.
+* Parameters: 	Refresh TTL (ms)
+/***********************************************************************************************************************/
+void RFM69OOKScene::setRefreshTtl(unsigned long int ttl)
+{
+	_ttl = ttl;
+}
+/***************************************************** invalidate ******************************************************
+* Function:  	Forget the commanded states, the next scenes send every requested device
+* Parameters: 	None
+/***********************************************************************************************************************/
+void RFM69OOKScene::invalidate()
+{
+	for (byte i = 0; i < _count; i++) _devices[i].known = false;
+}
+/****************************************************** compile ********************************************************
+* Function:  	Plan the commands of the current scene. For each KAKU New house, the unit commands of the requested
+*				devices to send are compared with a group command ON or OFF followed by a unit command for each
+*				device of the house left in another state; the group is kept when strictly shorter. Each house is
+*				evaluated once over all its devices. Other devices get a unit 
+*				command when needed. Air times are computed with the timing parameters of the RFM69OOK instance,
+*				the frames encoded to plan are not traced.
+* Parameters: 	RFM69OOK instance
+* Returns:		Plan of the current scene
+/***********************************************************************************************************************/
+const OokScenePlan &RFM69OOKScene::compile(RFM69OOK &ook)
+{
+	unsigned long int now = millis();
+	ook._traceMuted = true;													// Frames encoded to plan, not sent
+	boolean done[OOK_SCENE_DEVICES];						// Device state set by a group command
+	boolean visited[OOK_SCENE_DEVICES];						// Device house evaluated for a group command
+	memset(&_plan, 0, sizeof(_plan));
+	memset(done, 0, sizeof(done));
+	memset(visited, 0, sizeof(visited));
+	for (byte i = 0; i < _count; i++)										// Each KAKU New house once, over all its devices
+	{
+		OokDevice &house = _devices[i];
+		if (visited[i] || house.protocol != OOK_KAKU_NEW) continue;
+		byte unitCost = 0;
+		byte groupCost[2] = { 1, 1 };						// Group OFF and ON followed by the differing units
+		boolean groupable = true;
+		for (byte j = 0; j < _count; j++)
+		{
+			OokDevice &device = _devices[j];
+			if (device.protocol != OOK_KAKU_NEW || device.addr != house.addr) continue;
+			visited[j] = true;
+			boolean on;
+			byte dimLevel;
+			if (!ookSceneState(device, on, dimLevel)) groupable = false;	// Unknown state, a group would change it
+			if (device.target && ookSceneNeeded(device, now)) unitCost++;
+			for (byte g = 0; g < 2; g++) if (on != g || dimLevel != 0) groupCost[g]++;
+		}
+		byte g = groupCost[1] < groupCost[0] ? 1 : 0;
+		if (!groupable || groupCost[g] >= unitCost) continue;				// Unit commands are decided below
+		ookScenePlan(ook, house, true, g, 0);
+		for (byte j = 0; j < _count; j++)
+		{
+			OokDevice &device = _devices[j];
+			if (device.protocol != OOK_KAKU_NEW || device.addr != house.addr) continue;
+			boolean on;
+			byte dimLevel;
+			ookSceneState(device, on, dimLevel);
+			if (on != g || dimLevel != 0) ookScenePlan(ook, device, false, on, dimLevel);
+			done[j] = true;
+		}
+	}
+	for (byte i = 0; i < _count; i++)
+	{
+		OokDevice &device = _devices[i];
+		if (done[i] || !device.target) continue;
+		if (ookSceneNeeded(device, now)) ookScenePlan(ook, device, false, device.targetOn, device.targetDim);
+		else _plan.skipped++;
+	}
+	OokFrame frame;
+	for (byte i = 0; i < _count; i++)										// Air time without planning
+	{
+		OokDevice &device = _devices[i];
+		if (!device.target) continue;
+		switch (device.protocol)
+		{
+			case OOK_KAKU_NEW:
+				ook.encodeKakuNew(frame, device.addr, device.unit, device.targetOn, false, device.targetDim);
+				break;
+			case OOK_KAKU_OLD:
+				ook.encodeKakuOld(frame, (char) device.addr, device.unit, device.targetOn);
+				break;
+			default:
+				ook.encodeKakuCogex(frame, (byte) device.addr, device.unit, device.targetOn);
+				break;
+		}
+		_plan.unitAirtimeUsec += ook.airtime(frame);
+	}
+	ook._traceMuted = false;
+	return _plan;
+}
+/******************************************************** send *********************************************************
+* Function:  	Plan the current scene and send the commands in one batch through the RFM69OOK command queue (see 
+*				flush), then record the commanded states of the switched devices and clear the scene. When the
+*				channel access drops or defers the sending, the commands are unqueued and the scene is kept.
+* Parameters: 	
+*				RFM69OOK instance, its command queue must be empty
+*				RFM69 radio instance
+* Returns:		Plan of the sent scene (see RFM69OOK::lastChannelAccess for a not sent scene)
+/***********************************************************************************************************************/
+const OokScenePlan &RFM69OOKScene::send(RFM69OOK &ook, RFM69 &radio)
+{
+	compile(ook);
+	for (byte i = 0; i < _plan.commands; i++)
+	{
+		OokCommand &command = _plan.command[i];
+		if (ook.queued() >= OOK_QUEUE_SIZE && !ookSceneFlush(ook, radio)) return _plan;
+		switch (command.protocol)
+		{
+			case OOK_KAKU_NEW:
+				ook.enqueueKakuNew(command.addr, command.unit, command.on, command.group, command.dimLevel);
+				break;
+			case OOK_KAKU_OLD:
+				ook.enqueueKakuOld((char) command.addr, command.unit, command.on);
+				break;
+			default:
+				ook.enqueueKakuCogex((byte) command.addr, command.unit, command.on);
+				break;
+		}
+	}
+	if (!ookSceneFlush(ook, radio)) return _plan;
+	unsigned long int now = millis();
+	for (byte i = 0; i < _plan.commands; i++)								// In sending order
+	{
+		OokCommand &command = _plan.command[i];
+		for (byte j = 0; j < _count; j++)
+		{
+			OokDevice &device = _devices[j];
+			if (device.protocol != command.protocol || device.addr != command.addr) continue;
+			if (!command.group && device.unit != command.unit) continue;
+			device.known = true;
+			device.on = command.on;
+			device.dimLevel = command.dimLevel;
+			device.time = now;
+		}
+	}
+	clearScene();
+	return _plan;
+}
+/*************************************************** ookSceneFlush ****************************************************
+* Function:  	Send the queued commands, unqueue them if the channel access drops or defers the sending
+* Parameters: 	
+*				RFM69OOK instance
+*				RFM69 radio instance
+* Returns:		false if the commands are not sent
+/***********************************************************************************************************************/
+boolean RFM69OOKScene::ookSceneFlush(RFM69OOK &ook, RFM69 &radio)
+{
+	if (ook.queued() == 0) return true;
+	ook.flush(radio);
+	byte result = ook.lastChannelAccess();
+	if (result == OOK_CHANNEL_READY || result == OOK_CHANNEL_FORCED) return true;
+	ook.clearQueue();
+	return false;
+}
+/**************************************************** ookSceneFind *****************************************************
+* Function:  	Find a known device
+* Parameters: 	Protocol, house address and unit address
+* Returns:		Device, NULL if unknown
+/***********************************************************************************************************************/
+OokDevice *RFM69OOKScene::ookSceneFind(byte protocol, unsigned long int addr, byte unit)
+{
+	for (byte i = 0; i < _count; i++)
+	{
+		OokDevice &device = _devices[i];
+		if (device.protocol == protocol && device.addr == addr && device.unit == unit) return &device;
+	}
+	return NULL;
+}
+/*************************************************** ookSceneState *****************************************************
+* Function:  	State a device is left in by the scene: the requested state, else the last commanded state
+* Parameters: 	
+*				Device
+*				State level and dim level, filled
+* Returns:		false if the device is not requested and its state is unknown
+/***********************************************************************************************************************/
+boolean RFM69OOKScene::ookSceneState(const OokDevice &device, boolean &on, byte &dimLevel)
+{
+	on = device.target ? device.targetOn : device.on;
+	dimLevel = device.target ? device.targetDim : device.dimLevel;
+	return device.target || device.known;
+}
+/************************************************** ookSceneNeeded *****************************************************
+* Function:  	Check if the requested state of a device must be sent: unknown, different or older than the TTL
+* Parameters: 	
+*				Device
+*				Current time (ms)
+/***********************************************************************************************************************/
+boolean RFM69OOKScene::ookSceneNeeded(const OokDevice &device, unsigned long int now)
+{
+	return !device.known || device.on != device.targetOn || device.dimLevel != device.targetDim || 
+		now - device.time >= _ttl;
+}
+/**************************************************** ookScenePlan *****************************************************
+* Function:  	Append a command to the plan with the timing parameters of the RFM69OOK instance and add its air time
+* Parameters: 	
+*				RFM69OOK instance
+*				Device (house address for a group command)
+*				Group command
+*				State level and dim level
+/***********************************************************************************************************************/
+void RFM69OOKScene::ookScenePlan(RFM69OOK &ook, const OokDevice &device, boolean group, boolean on, byte dimLevel)
+{
+	if (_plan.commands >= OOK_SCENE_DEVICES) return;
+	OokCommand &command = _plan.command[_plan.commands++];
+	OokFrame frame;
+	command.protocol = device.protocol;
+	command.addr = device.addr;
+	command.unit = group ? 0 : device.unit;
+	command.on = on;
+	command.group = group;
+	command.dimLevel = dimLevel;
+	switch (device.protocol)
+	{
+		case OOK_KAKU_NEW:
+			ook.encodeKakuNew(frame, device.addr, command.unit, on, group, dimLevel);
+			break;
+		case OOK_KAKU_OLD:
+			ook.encodeKakuOld(frame, (char) device.addr, device.unit, on);
+			break;
+		default:
+			ook.encodeKakuCogex(frame, (byte) device.addr, device.unit, on);
+			break;
+	}
+	command.periodusec = frame.periodusec;
+	command.repeats = frame.repeats;
+	command.repDly = frame.repDly;
+	if (group) _plan.groups++;
+	_plan.airtimeUsec += ook.airtime(frame);
+}
+/***********************************************************************************************************************/
+
+#if OOK_SERVICE
+/**************************************************** OokCompletion *****************************************************
+* Function:  	Define a completion
+* Parameters: 	
+*				Function called by the worker when the command is terminated, NULL if none
+*				Callback parameter
+/***********************************************************************************************************************/
+OokCompletion::OokCompletion(OokCompletionCallback callback, void *context) :
+	_done(false), _result(OOK_CHANNEL_BUSY), _callback(callback), _context(context)
+{
+}
+/******************************************************** done *********************************************************
+* Function:  	Test if the command is terminated
+* Returns:		true once the worker has run the command
+/***********************************************************************************************************************/
+boolean OokCompletion::done()
+{
+	return _done.load(std::memory_order_acquire);
+}
+/******************************************************* result ********************************************************
+* Function:  	Get the result of the terminated command
+* Returns:		OOK_CHANNEL_READY or OOK_CHANNEL_FORCED if sent, OOK_CHANNEL_DROPPED or OOK_CHANNEL_DEFERRED if not, 
+*				OOK_CHANNEL_BUSY while the command is not terminated
+/***********************************************************************************************************************/
+byte OokCompletion::result()
+{
+	return done() ? _result : OOK_CHANNEL_BUSY;
+}
+/******************************************************** wait *********************************************************
+* Function:  	Wait for the command termination, letting the other tasks run
+/***********************************************************************************************************************/
+void OokCompletion::wait()
+{
+	while (!done()) yield();
+}
+/*************************************************** OokServiceQueue ****************************************************
+* Function:  	Define an empty queue: cell i is ready for the push at position i
+/***********************************************************************************************************************/
+OokServiceQueue::OokServiceQueue() : _head(0), _tail(0)
+{
+	for (unsigned int i = 0; i < OOK_SERVICE_QUEUE; i++) _cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+/******************************************************** push *********************************************************
+* Function:  	Queue a command without blocking, from any task
+* Parameters: 	Command
+* Returns:		false if the queue is full
+/***********************************************************************************************************************/
+boolean OokServiceQueue::push(const OokServiceCommand &command)
+{
+	unsigned int position = _head.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		Cell &cell = _cells[position & (OOK_SERVICE_QUEUE - 1)];
+		int diff = (int) (cell.sequence.load(std::memory_order_acquire) - position);
+		if (diff == 0)														// Free cell: reserve it
+		{
+			if (_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				cell.command = command;
+				cell.sequence.store(position + 1, std::memory_order_release);	// Publish it to the worker
+				return true;
+			}
+		}
+		else if (diff < 0) return false;									// Not yet taken by the worker: full
+		else position = _head.load(std::memory_order_relaxed);				// Reserved by another task meanwhile
+	}
+}
+/********************************************************* pop *********************************************************
+* Function:  	Take the oldest published command, from the worker only
+* Parameters: 	Command to fill
+* Returns:		false if no command is published
+/***********************************************************************************************************************/
+boolean OokServiceQueue::pop(OokServiceCommand &command)
+{
+	Cell &cell = _cells[_tail & (OOK_SERVICE_QUEUE - 1)];
+	if (cell.sequence.load(std::memory_order_acquire) != _tail + 1) return false;
+	command = cell.command;
+	cell.sequence.store(_tail + OOK_SERVICE_QUEUE, std::memory_order_release);	// Free the cell for the next turn
+	_tail++;
+	return true;
+}
+/*************************************************** RFM69OOKService ****************************************************
+* Function:  	Define a transmit service
+* Parameters: 	
+*				RFM69OOK instance, only used by the worker from now
+*				RFM69 radio instance, only used by the worker from now
+/***********************************************************************************************************************/
+RFM69OOKService::RFM69OOKService(RFM69OOK &ook, RFM69 &radio) : _ook(ook), _radio(radio), _rejected(0)
+{
+}
+/******************************************************* submit ********************************************************
+* Function:  	Queue a KAKU command, sent with its own timing parameters
+* Parameters: 	
+*				Command (protocol, address, unit, state, dim level, group option, period, repeats, repeat delay)
+*				Priority: OOK_PRIORITY_HIGH, OOK_PRIORITY_NORMAL or OOK_PRIORITY_LOW
+*				Completion, NULL if none
+* Returns:		false if the queue of the priority is full
+/***********************************************************************************************************************/
+boolean RFM69OOKService::submit(const OokCommand &command, byte priority, OokCompletion *completion)
+{
+	OokServiceCommand queued;
+	queued.kind = OOK_SERVICE_KAKU;
+	queued.command = command;
+	queued.data = NULL;
+	queued.function = NULL;
+	return ookServiceSubmit(queued, priority, completion);
+}
+/***************************************************** submitFrame *****************************************************
+* Function:  	Queue an encoded frame
+* Parameters: 	
+*				Frame, must stay valid until the command is terminated
+*				Priority and completion (see submit)
+* Returns:		false if the queue of the priority is full
+/***********************************************************************************************************************/
+boolean RFM69OOKService::submitFrame(const OokFrame &frame, byte priority, OokCompletion *completion)
+{
+	OokServiceCommand queued;
+	queued.kind = OOK_SERVICE_FRAME;
+	queued.data = &frame;
+	queued.function = NULL;
+	return ookServiceSubmit(queued, priority, completion);
+}
+/**************************************************** submitCapture ****************************************************
+* Function:  	Queue a raw capture
+* Parameters: 	
+*				Capture in program memory (see RFM69OOK::encodeCapture)
+*				Priority and completion (see submit)
+* Returns:		false if the queue of the priority is full
+/***********************************************************************************************************************/
+boolean RFM69OOKService::submitCapture(const byte *capture, byte priority, OokCompletion *completion)
+{
+	OokServiceCommand queued;
+	queued.kind = OOK_SERVICE_CAPTURE;
+	queued.data = capture;
+	queued.function = NULL;
+	return ookServiceSubmit(queued, priority, completion);
+}
+/***************************************************** submitRadio *****************************************************
+* Function:  	Queue a function run by the worker with the exclusive use of the radio
+* Parameters: 	
+*				Function, called with the RFM69 instance and its context
+*				Context, must stay valid until the command is terminated
+*				Priority and completion (see submit), the result is OOK_CHANNEL_READY
+* Returns:		false if the queue of the priority is full
+/***********************************************************************************************************************/
+boolean RFM69OOKService::submitRadio(OokRadioFunction function, void *context, byte priority, OokCompletion *completion)
+{
+	OokServiceCommand queued;
+	queued.kind = OOK_SERVICE_RADIO;
+	queued.data = context;
+	queued.function = function;
+	return ookServiceSubmit(queued, priority, completion);
+}
+/******************************************************** poll *********************************************************
+* Function:  	Run the oldest command of the highest priority, to be called in a loop by the worker task only
+* Returns:		false if no command is queued
+/***********************************************************************************************************************/
+boolean RFM69OOKService::poll()
+{
+	OokServiceCommand command;
+	byte priority = 0;
+	while (!_queues[priority].pop(command)) 
+		if (++priority >= OOK_PRIORITIES) return false;
+	byte result = ookServiceRun(command);
+	OokCompletion *completion = command.completion;
+	if (completion)
+	{
+		completion->_result = result;
+		if (completion->_callback) completion->_callback(*completion, completion->_context);
+		completion->_done.store(true, std::memory_order_release);		// Last access: the owner may reuse it
+	}
+	return true;
+}
+/****************************************************** rejected *******************************************************
+* Function:  	Get the number of commands refused on a full queue
+* Returns:		Number of refused commands since the service creation
+/***********************************************************************************************************************/
+unsigned long int RFM69OOKService::rejected()
+{
+	return _rejected.load(std::memory_order_relaxed);
+}
+/************************************************** ookServiceSubmit ***************************************************
+* Function:  	Queue a command in the queue of its priority
+* Parameters: 	
+*				Command, completed with its completion
+*				Priority, lowest if out of range
+*				Completion, NULL if none
+* Returns:		false if the queue is full
+/***********************************************************************************************************************/
+boolean RFM69OOKService::ookServiceSubmit(OokServiceCommand &command, byte priority, OokCompletion *completion)
+{
+	if (priority >= OOK_PRIORITIES) priority = OOK_PRIORITIES - 1;
+	command.completion = completion;
+	if (completion) completion->_done.store(false, std::memory_order_relaxed);
+	if (_queues[priority].push(command)) return true;
+	_rejected.fetch_add(1, std::memory_order_relaxed);
+	if (completion)															// Terminated as dropped
+	{
+		completion->_result = OOK_CHANNEL_DROPPED;
+		if (completion->_callback) completion->_callback(*completion, completion->_context);
+		completion->_done.store(true, std::memory_order_release);
+	}
+	return false;
+}
+/*************************************************** ookServiceRun ****************************************************
+* Function:  	Run a command in the worker
+* Parameters: 	Command
+* Returns:		Channel access result of the sending (see RFM69OOK::lastChannelAccess), OOK_CHANNEL_READY for a function
+/***********************************************************************************************************************/
+byte RFM69OOKService::ookServiceRun(const OokServiceCommand &command)
+{
+	switch (command.kind)
+	{
+		case OOK_SERVICE_KAKU:
+		{
+			const OokCommand &kaku = command.command;
+			_ook.setOokParams(kaku.periodusec, kaku.repeats, kaku.repDly);
+			switch (kaku.protocol)
+			{
+				case OOK_KAKU_NEW:
+					_ook.sendKakuNew(_radio, kaku.addr, kaku.unit, kaku.on, kaku.group, kaku.dimLevel);
+					break;
+				case OOK_KAKU_OLD:
+					_ook.sendKakuOld(_radio, (char) kaku.addr, kaku.unit, kaku.on);
+					break;
+				default:
+					_ook.sendKakuCogex(_radio, (byte) kaku.addr, kaku.unit, kaku.on);
+					break;
+			}
+			break;
+		}
+		case OOK_SERVICE_FRAME:
+			_ook.sendFrame(_radio, *(const OokFrame *) command.data);
+			break;
+		case OOK_SERVICE_CAPTURE:
+			_ook.sendCapture(_radio, (const byte *) command.data);
+			break;
+		default:
+			command.function(_radio, (void *) command.data);
+			return OOK_CHANNEL_READY;
+	}
+	return _ook.lastChannelAccess();
+}
+#endif
+/***********************************************************************************************************************/
+
+RFM69OOKReceiver *RFM69OOKReceiver::_owner = NULL;
+// Registers saved and restored around a reception (OPMODE restored last)
+static const byte ookRxRegs[] = { REG_DATAMODUL, REG_OOKPEAK, REG_RXBW, REG_OPMODE };
+// Descriptors of the decoded protocols, indexed by OOK_KAKU_...
+static const OokProtocol *const ookRxProtocols[] = { &OOK_PROTO_KAKU_NEW, &OOK_PROTO_KAKU_OLD, &OOK_PROTO_COGEX };
+
+/************************************************** RFM69OOKReceiver ***************************************************
+* Function:  	Define a RFM69OOKReceiver Class, KAKU New and Old frames are decoded
+* Parameters:	Processor pin connected to the RFM69 DIO2 pin (default RF69_OOK_PIN)
+/***********************************************************************************************************************/
+RFM69OOKReceiver::RFM69OOKReceiver()
+{
+	_ookDataPin = RF69_OOK_PIN;
+	_radio = NULL;
+	setRxProtocols(_BV(OOK_KAKU_NEW) | _BV(OOK_KAKU_OLD));
+	memset(&_message, 0, sizeof(_message));
+	memset(&_stats, 0, sizeof(_stats));
+}
+RFM69OOKReceiver::RFM69OOKReceiver(byte dataPin)
+{
+	_ookDataPin = dataPin;
+	_radio = NULL;
+	setRxProtocols(_BV(OOK_KAKU_NEW) | _BV(OOK_KAKU_OLD));
+	memset(&_message, 0, sizeof(_message));
+	memset(&_stats, 0, sizeof(_stats));
+}
+/*************************************************** setRxProtocols ****************************************************
+* Function:  	Select the decoded protocols. KAKU Old and Cogex frames have the same format: a frame is reported as 
+*				Cogex only when the Old protocol is not selected.
+* Parameters: 	Bit mask of the protocols, ex: _BV(OOK_KAKU_NEW) | _BV(OOK_KAKU_COGEX)
+/***********************************************************************************************************************/
+void RFM69OOKReceiver::setRxProtocols(byte mask)
+{
+	_protocols = mask;
+	for (byte i = 0; i < 3; i++) memcpy_P(&_decoders[i].p, ookRxProtocols[i], sizeof(OokProtocol));
+	ookRxReset();
+}
+/******************************************************* begin *********************************************************
+* Function:  	Save the RFM69 registers, set continuous OOK reception with a peak threshold and start recording the 
+*				DIO2 edges. The RFM69 instance must not be used until end() is called.
+* Parameters: 	RFM69 radio instance
+* Returns:		false when another receiver is active
+/***********************************************************************************************************************/
+boolean RFM69OOKReceiver::begin(RFM69 &radio)
+{
+	if (_owner != NULL) return false;
+	_radio = &radio;
+	for (byte i = 0; i < sizeof(ookRxRegs); i++) _saved[i] = radio.readReg(ookRxRegs[i]);
+	radio.writeReg(REG_OPMODE, RF_OPMODE_STANDBY);
+	radio.writeReg(REG_DATAMODUL, RF_DATAMODUL_DATAMODE_CONTINUOUSNOBSYNC|RF_DATAMODUL_MODULATIONTYPE_OOK);
+	radio.writeReg(REG_OOKPEAK, RF_OOKPEAK_THRESHTYPE_PEAK|RF_OOKPEAK_PEAKTHRESHSTEP_000|RF_OOKPEAK_PEAKTHRESHDEC_000);
+	radio.writeReg(REG_RXBW, RF_RXBW_DCCFREQ_010|RF_RXBW_MANT_16|RF_RXBW_EXP_1);
+	radio.writeReg(REG_OPMODE, RF_OPMODE_RECEIVER);
+	_head = 0;
+	_tail = 0;
+	_overruns = 0;
+	_seenOverruns = 0;
+	ookRxReset();
+	pinMode(_ookDataPin, INPUT);
+	_lastEdge = micros();
+	_owner = this;
+	attachInterrupt(digitalPinToInterrupt(_ookDataPin), ookRxIsr, CHANGE);
+	return true;
+}
+/******************************************************** end **********************************************************
+* Function:  	Stop recording the DIO2 edges, restore the RFM69 registers and set the pin back to a LOW output
+* Parameters: 	None
+/***********************************************************************************************************************/
+void RFM69OOKReceiver::end()
+{
+	if (_owner != this) return;
+	detachInterrupt(digitalPinToInterrupt(_ookDataPin));
+	_owner = NULL;
+	_radio->writeReg(REG_OPMODE, RF_OPMODE_STANDBY);
+	for (byte i = 0; i < sizeof(ookRxRegs); i++) _radio->writeReg(ookRxRegs[i], _saved[i]);
+	pinMode(_ookDataPin, OUTPUT);
+	digitalWrite(_ookDataPin, LOW);
+}
+/****************************************************** ookRxIsr *******************************************************
+* Function:  	Pin change interrupt handler, never blocks nor allocates
+/***********************************************************************************************************************/
+void OOK_ISR_ATTR RFM69OOKReceiver::ookRxIsr()
+{
+	if (_owner) _owner->ookRxEdge();
+}
+/***************************************************** ookRxEdge *******************************************************
+* Function:  	Record the duration of the level ended by the edge. The ring is only written here (head) and only 
+*				read by receiveDone (tail); on a full ring the edge is counted as an overrun and dropped.
+/***********************************************************************************************************************/
+void OOK_ISR_ATTR RFM69OOKReceiver::ookRxEdge()
+{
+	unsigned long int now = micros();
+	unsigned long int dur = now - _lastEdge;
+	_lastEdge = now;
+	byte head = _head;
+	byte next = (head + 1) & (OOK_RX_RING_SIZE - 1);
+	if (next == _tail)
+	{
+		_overruns++;
+		return;
+	}
+	if (dur > OOK_RX_DUR_MAX) dur = OOK_RX_DUR_MAX;
+	_ring[head] = dur | (digitalRead(_ookDataPin) ? 0 : 0x8000);	// A LOW pin ends a HIGH level
+	_head = next;
+}
+/**************************************************** receiveDone ******************************************************
+* Function:  	Decode the recorded edges, to be called often enough from the main loop to keep the ring from 
+*				overflowing (one frame repeat is about 140 edges). A frame ending on a LOW level is closed after 
+*				OOK_RX_TIMEOUT us of silence. Repeats of the last message are counted and not reported again.
+* Returns:		true when a new message is available through getMessage
+/***********************************************************************************************************************/
+boolean RFM69OOKReceiver::receiveDone()
+{
+	if (_overruns != _seenOverruns)						// Edges were lost, the current frames are corrupted
+	{
+		_seenOverruns = _overruns;
+		_stats.overruns = _seenOverruns;
+		ookRxReset();
+	}
+	while (_tail != _head)
+	{
+		unsigned int entry = _ring[_tail];
+		_tail = (_tail + 1) & (OOK_RX_RING_SIZE - 1);
+		_stats.edges++;
+		if (ookRxLevel(entry & 0x8000, entry & OOK_RX_DUR_MAX)) return true;
+	}
+	if (_pendingHigh)
+	{
+		noInterrupts();
+		unsigned long int silence = micros() - _lastEdge;
+		boolean idle = (_tail == _head);
+		interrupts();
+		if (idle && silence > OOK_RX_TIMEOUT) return ookRxLevel(false, silence);
+	}
+	return false;
+}
+/***************************************************** getMessage ******************************************************
+* Function:  	Last received message
+/***********************************************************************************************************************/
+const OokMessage &RFM69OOKReceiver::getMessage()
+{
+	return _message;
+}
+/***************************************************** getRxStats ******************************************************
+* Function:  	Receiver counters
+/***********************************************************************************************************************/
+const OokRxStats &RFM69OOKReceiver::getRxStats()
+{
+	return _stats;
+}
+/****************************************************** ookRxReset *****************************************************
+* Function:  	Restart all decoders waiting for a sync pulse
+/***********************************************************************************************************************/
+void RFM69OOKReceiver::ookRxReset()
+{
+	for (byte i = 0; i < 3; i++) _decoders[i].period = 0;
+	_pendingHigh = false;
+	_prevLow = 0;
+}
+/***************************************************** ookRxLevel ******************************************************
+* Function:  	Pair a HIGH level with the next LOW level and feed the pulse to the decoders. A LOW level longer than 
+*				OOK_RX_TIMEOUT ends the frames in progress (truncated or corrupted by an overrun), so that the sync 
+*				pulse of the next frame is not taken as a symbol.
+* Parameters: 	
+*				true for a HIGH level
+*				Level duration (us)
+* Returns:		true when a new message is received
+/***********************************************************************************************************************/
+boolean RFM69OOKReceiver::ookRxLevel(boolean high, unsigned long int dur)
+{
+	if (high)
+	{
+		_high = _pendingHigh ? _high + dur : dur;		// Consecutive HIGH levels are merged
+		_pendingHigh = true;
+		return false;
+	}
+	boolean received = false;
+	if (!_pendingHigh) _prevLow += dur;					// Continued LOW level (silence closed by receiveDone)
+	else
+	{
+		_pendingHigh = false;
+		received = ookRxPulse(_high, dur);
+		_prevLow = dur;
+	}
+	if (_prevLow > OOK_RX_TIMEOUT) for (byte i = 0; i < 3; i++) _decoders[i].period = 0;
+	return received;
+}
+/***************************************************** ookRxPulse ******************************************************
+* Function:  	Feed a HIGH/LOW pulse to the decoders of the selected protocols. The first complete frame restarts 
+*				all decoders.
+* Parameters: 	
+*				HIGH and LOW durations (us)
+* Returns:		true when a new message is received
+/***********************************************************************************************************************/
+boolean RFM69OOKReceiver::ookRxPulse(unsigned int high, unsigned long int low)
+{
+	for (byte i = 0; i < 3; i++)
+	{
+		if (!bitRead(_protocols, i) || !ookRxDecode(_decoders[i], high, low, true)) continue;
+		_stats.frames++;
+		boolean received = ookRxMessage(i, _decoders[i]);
+		for (byte j = 0; j < 3; j++) _decoders[j].period = 0;
+		return received;
+	}
+	return false;
+}
+/****************************************************** ookRxNear ******************************************************
+* Function:  	Compare a duration to a number of OOK pulse times, within half its length plus half a pulse time
+* Parameters: 	
+*				Duration (us)
+*				Number of pulse times
+*				OOK pulse time (us)
+*				true when the level may be longer (last LOW of a frame, merged with the silence that follows)
+*				Sum of the differences, incremented
+/***********************************************************************************************************************/
+static boolean ookRxNear(unsigned long int dur, byte units, unsigned int period, boolean open, unsigned long int &error)
+{
+	unsigned long int nominal = (unsigned long int)units * period;
+	if (open && dur > nominal) return true;
+	unsigned long int diff = dur > nominal ? dur - nominal : nominal - dur;
+	error += diff;
+	return diff <= nominal / 2 + period / 2;
+}
+/***************************************************** ookRxDecode *****************************************************
+* Function:  	Feed a HIGH/LOW pulse to the decoder of a protocol descriptor:
+*				- waiting for a sync pulse, the pulse time is measured on the pulse matching the descriptor sync
+*				  (after a LOW level longer than the lead LOW when the protocol has one)
+*				- each symbol is matched against the symbols of the descriptor, the nearest one within the 
+*				  tolerance is kept; the dim symbol is only accepted at the dim position
+*				- the frame is complete on the tail pulse, or on the last symbol without a tail
+*				On a mismatch the decoder restarts and the pulse is tried once more as a sync pulse.
+* Parameters: 	
+*				Decoder
+*				HIGH and LOW durations (us)
+*				true to try the pulse as a sync pulse on a mismatch
+* Returns:		true when the frame is complete
+/***********************************************************************************************************************/
+boolean RFM69OOKReceiver::ookRxDecode(OokRxDecoder &d, unsigned int high, unsigned long int low, boolean retry)
+{
+	const OokProtocol &p = d.p;
+	unsigned long int error = 0;
+	if (d.period == 0)
+	{
+		unsigned long int period = (high + low) / (p.syncHigh + p.syncLow);	// Immune to the HIGH/LOW balance
+		if (period < OOK_RX_MIN_PERIOD || period > OOK_RX_MAX_PERIOD) return false;
+		if (!ookRxNear(high, p.syncHigh, period, false, error) || !ookRxNear(low, p.syncLow, period, false, error))
+			return false;
+		if (p.leadLow && _prevLow < (p.leadLow + 1) * period) return false;
+		d.period = period;
+		d.half = false;
+		d.symbols = 0;
+		d.dimmed = false;
+		d.dimLevel = 0;
+		d.data = 0;
+		return false;
+	}
+	byte total = p.bits + (d.dimmed ? p.dimBits : 0);
+	if (d.symbols == total)									// Tail pulse
+	{
+		if (ookRxNear(high, p.tailHigh, d.period, false, error) && ookRxNear(low, p.tailLow, d.period, true, error))
+			return true;
+		d.period = 0;
+		return retry && ookRxDecode(d, high, low, false);
+	}
+	boolean twoPulses = p.symbol[OOK_SYMBOL_ZERO][2] != 0;
+	if (twoPulses && !d.half)
+	{
+		d.high = high;
+		d.low = low > 0xFFFF ? 0xFFFF : low;
+		d.half = true;
+		return false;
+	}
+	d.half = false;
+	boolean last = (p.tailHigh == 0 && d.symbols + 1 == total);
+	byte candidates = OOK_SYMBOL_FLOAT + 1;
+	if (d.symbols >= p.bits) candidates = OOK_SYMBOL_ONE + 1;				// Dim level bits
+	else if ((p.flags & OOK_DIM_EXT) && d.symbols == p.dimPos) candidates = OOK_SYMBOL_DIM + 1;
+	byte best = 0xFF;
+	unsigned long int bestError = 0;
+	for (byte s = 0; s < candidates; s++)
+	{
+		const byte *symbol = p.symbol[s];
+		if (symbol[0] == 0) continue;										// Symbol not used by the protocol
+		error = 0;
+		boolean match;
+		if (twoPulses) match = ookRxNear(d.high, symbol[0], d.period, false, error) && 
+			ookRxNear(d.low, symbol[1], d.period, false, error) && ookRxNear(high, symbol[2], d.period, false, error) &&
+			ookRxNear(low, symbol[3], d.period, last, error);
+		else match = ookRxNear(high, symbol[0], d.period, false, error) && 
+			ookRxNear(low, symbol[1], d.period, last, error);
+		if (match && (best == 0xFF || error < bestError))
+		{
+			best = s;
+			bestError = error;
+		}
+	}
+	if (best == 0xFF || best == OOK_SYMBOL_FLOAT)							// No tri-state KAKU message
+	{
+		d.period = 0;
+		return retry && ookRxDecode(d, high, low, false);
+	}
+	if (d.symbols >= p.bits) d.dimLevel = (d.dimLevel << 1) | best;			// Dim level MSB bits first
+	else if (best == OOK_SYMBOL_DIM) d.dimmed = true;
+	else if (best == OOK_SYMBOL_ONE) bitSet(d.data, (p.flags & OOK_MSB_FIRST) ? p.bits - 1 - d.symbols : d.symbols);
+	d.symbols++;
+	return last;
+}
+/**************************************************** ookRxMessage *****************************************************
+* Function:  	Convert a complete frame into the send function fields of its protocol. A frame identical to the 
+*				last message within OOK_RX_REPEAT_MS is counted as one of its repeats.
+* Parameters: 	
+*				Protocol (OOK_KAKU_...)
+*				Decoder of the complete frame
+* Returns:		true for a new message
+/***********************************************************************************************************************/
+boolean RFM69OOKReceiver::ookRxMessage(byte protocol, const OokRxDecoder &d)
+{
+	unsigned long int now = millis();
+	byte dimLevel = d.dimmed ? d.dimLevel : 0;
+	if (protocol != OOK_KAKU_NEW && (d.data & 0x600) != 0x600) return false;	// Fixed float bits
+	if (_message.repeats && _message.protocol == protocol && _message.data == d.data && 
+		_message.dimLevel == dimLevel && now - _messageTime < OOK_RX_REPEAT_MS)
+	{
+		if (_message.repeats < 0xFF) _message.repeats++;
+		_messageTime = now;
+		return false;
+	}
+	_message.protocol = protocol;
+	_message.data = d.data;
+	_message.periodusec = d.period;
+	_message.repeats = 1;
+	_message.group = false;
+	_message.dimLevel = dimLevel;
+	_messageTime = now;
+	switch (protocol)
+	{
+		case OOK_KAKU_NEW:										// Address << 6 | group 0x20 | on 0x10 | unit - 1
+			_message.addr = d.data >> 6;
+			_message.group = (d.data & 0x20) != 0;
+			_message.unit = _message.group ? 0 : (d.data & 0x0F) + 1;
+			_message.on = d.dimmed || (d.data & 0x10) != 0;			// The dim symbol replaces the on level
+			break;
+		case OOK_KAKU_OLD:										// on 0x800 | 0x600 | (unit - 1) << 4 | address - 'A'
+			_message.addr = (d.data & 0x0F) + 'A';
+			_message.unit = ((d.data >> 4) & 0x0F) + 1;
+			_message.on = (d.data & 0x800) != 0;
+			break;
+		default:												// on 0x801 | 0x600 | unit << 5 | address << 1
+			_message.addr = (d.data >> 1) & 0x0F;
+			_message.unit = (d.data >> 5) & 0x0F;
+			_message.on = (d.data & 0x800) != 0;
+			break;
+	}
+	return true;
+}
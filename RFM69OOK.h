@@ -24,10 +24,21 @@ This library makes reference to RFM69(H)W_OOK_Library_Vx.y.pdf
 #include "RFM69.h"
 #include "RFM69registers.h"
 #include <Arduino.h>
+// Transmit service for multi-task targets (see RFM69OOKService), 0 to compile it out. It needs std::atomic.
+#ifndef OOK_SERVICE
+	#if defined(ESP32) || defined(__linux__)
+		#define OOK_SERVICE   1
+	#else
+		#define OOK_SERVICE   0
+	#endif
+#endif
+#if OOK_SERVICE
+	#include <atomic>
+#endif
 
-extern boolean RFM69OOK_DEBUG; 		// Debug option defined by the 
+extern boolean RFM69OOK_DEBUG; 		// Debug option defined by the sketch: record trace events (see dumpTrace)
 #define MAJOR 1						// Major version
-#define MINOR 4						// Minor version
+#define MINOR 23						// Minor version
 /**************************************** Revision History **************************************************************
 * 1.0 - First release
 * 1.1 - Correct ATMEGA2560 DIO2 pin from 19 to 18
@@ -35,25 +46,567 @@ extern boolean RFM69OOK_DEBUG; 		// Debug option defined by the
 *	    value calcutation crash with the ESP8266
 * 1.3 - Save and restore of Bit rate MSB and LSB register while calling a OOK function 
 * 1.4 - Add pre and post sending procedure for OOK frame sending
+* 1.5 - Split OOK sending in an encode stage (OokFrame) and an emit stage replaying the frame for each repeat
+* 1.6 - Add non-blocking timer-interrupt driven sending (beginSend..., isBusy, onSendDone) with OokTimer backends
+* 1.7 - Add a command queue sent in one batch sharing a single pre and post sending procedure (flush)
+* 1.8 - Add an optional shadow cache of the RFM69 registers used by the pre and post sending procedures
+* 1.9 - Edges are output against absolute deadlines, the processing delay is measured by calibrate()
+* 1.10 - Add RFM69OOKFast<PIN> with the OOK data pin port register and bit mask resolved at compile time
+* 1.11 - Add the FIFO transmit backend: frames are sent by the RFM69 packet engine, no DIO2 connection is needed
+* 1.12 - Table-driven encoder using OokProtocol descriptors, add PT2262, EV1527 and HomeEasy descriptors
+* 1.13 - Add airtime() and dryRun() edge error measurement of encoded frames
+* 1.14 - Add RFM69OOKReceiver: interrupt-driven OOK reception with a streaming KAKU New, Old and Cogex decoder
+* 1.15 - Add transmit telemetry (getStats): frames, repeats, TX on time, CSMA waits, register accesses, edge lateness
+* 1.16 - Add RFM69OOKMulti: frames of several RFM69 sent at the same time from one merged edge schedule
+* 1.17 - Add RFM69OOKScene: scene compiler using New group commands and a device state cache to skip redundant sends
+* 1.18 - Add non-blocking channel access (channelAccess): RSSI threshold, random backoff, force/drop/defer policy
+* 1.19 - Add raw captures: quantized pulse symbol table and packed indices replayed from program memory
+* 1.20 - Replace the Serial debug output (printOokInfos) by a binary trace ring printed later by dumpTrace
+* 1.21 - Add FSK coexistence: FSK packets are received between OOK repeats with a bounded blind window
+* 1.22 - Add RFM69OOKService: one worker owning the radio, fed by a lock-free MPSC queue per priority (ESP32, Linux)
+* 1.23 - Add the low power mode (RFM69 standby and MCU sleep between repeats) and the per sending charge estimation
 ************************************************************************************************************************/
-// RFM69 DIO2 pin should be connected on ATmega328 pin D3
+// RFM69 DIO2 pin should be connected on ATmega328 pin D3 (PD3)
 #if defined(__AVR_ATmega328P__) 
 	#define RF69_OOK_PIN          3
-// RFM69 DIO2 pin should be connected on ATmega1284P pin D11
+	#define RF69_OOK_PORT         PORTD
+	#define RF69_OOK_BIT          3
+// RFM69 DIO2 pin should be connected on ATmega1284P pin D11 (PD3)
 #elif defined(__AVR_ATmega1284P__)
 	#define RF69_OOK_PIN          11
-// RFM69 DIO2 pin should be connected on ATmega2560 pin D18 using RFM69 Shield
+	#define RF69_OOK_PORT         PORTD
+	#define RF69_OOK_BIT          3
+// RFM69 DIO2 pin should be connected on ATmega2560 pin D18 (PD3) using RFM69 Shield
 #elif defined(__AVR_ATmega2560__)
 	#define RF69_OOK_PIN          18
-// RFM69 DIO2 pin should be connected on ATmega32U4 pin D2	 
+	#define RF69_OOK_PORT         PORTD
+	#define RF69_OOK_BIT          3
+// RFM69 DIO2 pin should be connected on ATmega32U4 pin D2 (PD1)
 #elif defined(__AVR_ATmega32U4__)
 	#define RF69_OOK_PIN          2
+	#define RF69_OOK_PORT         PORTD
+	#define RF69_OOK_BIT          1
 // Default value enabling the change with the setOokPin function
 #else 
     #define RF69_OOK_PIN          3
 #endif
+// Maximum number of HIGH/LOW durations in an encoded frame (New Kaku with dim level is the longest: 148)
+#define OOK_FRAME_MAX_EDGES   148
+// HIGH levels are shortened (and the next LOW lengthened) by this time to compensate the RFM69 OOK output (us)
+#define OOK_PULSE_TRIM        150
+// Trim of a HIGH level: OOK_PULSE_TRIM, at most 3/4 of the level so that short pulses (100 us PT2262) keep a HIGH
+#define OOK_HIGH_TRIM(high)   ((high) - (high) / 4 < OOK_PULSE_TRIM ? (high) - (high) / 4 : OOK_PULSE_TRIM)
+// Default digitalWrite processing delay until calibrate() is called (us)
+#if defined(__AVR__)
+	#define OOK_EDGE_LEAD     4
+#else
+	#define OOK_EDGE_LEAD     1
+#endif
+// Number of commands that can be queued for a batched sending
+#ifndef OOK_QUEUE_SIZE
+	#define OOK_QUEUE_SIZE    8
+#endif
+// Transmit backends (see setOokBackend)
+#define OOK_BACKEND_DIO2      0
+#define OOK_BACKEND_FIFO      1
+// RFM69 FIFO size, refill threshold (bytes) and longest OOK pulse time for the FIFO backend (16 bits bit rate)
+#define OOK_FIFO_SIZE         66
+#define OOK_FIFO_THRESHOLD    33
+#define OOK_FIFO_MAX_PERIOD   2047
+#ifndef RF_PACKET2_AES_ON
+	#define RF_PACKET2_AES_ON 0x01
+#endif
+// Maximum number of transmitters driven together by RFM69OOKMulti
+#ifndef OOK_MULTI_CHANNELS
+	#define OOK_MULTI_CHANNELS 4
+#endif
+// Number of devices known by RFM69OOKScene and default time a commanded state is trusted (ms)
+#ifndef OOK_SCENE_DEVICES
+	#define OOK_SCENE_DEVICES 8
+#endif
+#define OOK_SCENE_TTL         3600000UL
+// Receiver edge ring size (power of 2, at most 128), longest recorded level and silence closing a frame (us)
+#ifndef OOK_RX_RING_SIZE
+	#define OOK_RX_RING_SIZE  64
+#endif
+#define OOK_RX_DUR_MAX        0x7FFF
+#define OOK_RX_TIMEOUT        12000
+// OOK pulse time range accepted by the receiver (us)
+#define OOK_RX_MIN_PERIOD     100
+#define OOK_RX_MAX_PERIOD     1000
+// Identical frames received within this delay are counted as repeats of the same message (ms)
+#define OOK_RX_REPEAT_MS      250
+// OOK protocols
+#define OOK_KAKU_NEW          0
+#define OOK_KAKU_OLD          1
+#define OOK_KAKU_COGEX        2
+// Telemetry slot of the frames not encoded by a KAKU function, number of telemetry protocol slots
+#define OOK_OTHER             3
+#define OOK_PROTOCOLS         4
+// Transmit telemetry counters (see getStats), 0 to compile them out
+#ifndef OOK_STATS
+	#define OOK_STATS         1
+#endif
+// Number of buckets of the CSMA wait histogram: 0 ms, up to 1, 10, 100 ms and longer
+#define OOK_CSMA_BUCKETS      5
+// Channel access policies applied when the channel stays busy up to the access time limit (see setChannelAccess)
+#define OOK_CSMA_FORCE        0
+#define OOK_CSMA_DROP         1
+#define OOK_CSMA_DEFER        2
+// Channel access results (see channelAccess)
+#define OOK_CHANNEL_BUSY      0
+#define OOK_CHANNEL_READY     1
+#define OOK_CHANNEL_FORCED    2
+#define OOK_CHANNEL_DROPPED   3
+#define OOK_CHANNEL_DEFERRED  4
+// Default random backoff between two busy RSSI samples and time a clear channel result stays valid (ms)
+#define OOK_BACKOFF_MIN       2
+#define OOK_BACKOFF_MAX       20
+#define OOK_GRANT_MS          5
+// Number of trace events kept (power of 2, at most 128), 0 to compile the trace out (see dumpTrace)
+#ifndef OOK_TRACE_SIZE
+	#define OOK_TRACE_SIZE    8
+#endif
+// Trace events
+#define OOK_TRACE_ENCODE      0				// Command encoded
+#define OOK_TRACE_SEND        1				// Frame sending started
+#define OOK_TRACE_ACCESS      2				// Channel access terminated
+// FSK packets kept when received between OOK repeats (see setCoexistence), 0 to compile the coexistence out
+#ifndef OOK_FSK_PACKETS
+	#define OOK_FSK_PACKETS   1
+#endif
+// Default shortest FSK reception time between two OOK repeats (ms)
+#define OOK_FSK_LISTEN_MS     10
+// Transmit service command kinds, priorities and commands queued per priority (power of 2)
+#define OOK_SERVICE_KAKU      0
+#define OOK_SERVICE_FRAME     1
+#define OOK_SERVICE_CAPTURE   2
+#define OOK_SERVICE_RADIO     3
+#define OOK_PRIORITY_HIGH     0
+#define OOK_PRIORITY_NORMAL   1
+#define OOK_PRIORITY_LOW      2
+#define OOK_PRIORITIES        3
+#ifndef OOK_SERVICE_QUEUE
+	#define OOK_SERVICE_QUEUE 8
+#endif
+// Shortest repeat gap put in standby by the low power mode and time left to the RFM69 to get back to transmit (us)
+#define OOK_STANDBY_MIN_USEC  1000
+#define OOK_WAKE_USEC         200
+// Default RFM69 supply currents of the charge estimation (uA): carrier on (RFM69W +13 dBm), transmit mode with the
+// carrier off, standby and receive
+#define OOK_CARRIER_UA        45000UL
+#define OOK_TX_IDLE_UA        9000UL
+#define OOK_STANDBY_UA        1250UL
+#define OOK_RX_UA             16000UL
+
+/****************************************************** OokFrame ********************************************************
+* Encoded OOK datagram: alternating HIGH/LOW durations in us, the first one being HIGH (a 0 duration is skipped).
+* The timing parameters in use at encoding time are kept with the frame, so a cached frame is replayed unchanged.
+/***********************************************************************************************************************/
+struct OokFrame {
+	unsigned int periodusec;				// OOK pulse time used to encode the frame
+	byte repeats;							// Number of time the frame is to be repeated
+	byte repDly;							// Delay between repeated frames (ms)
+	byte length;							// Number of durations in the frame
+	byte protocol;							// Telemetry slot: OOK_KAKU_NEW, OOK_KAKU_OLD, OOK_KAKU_COGEX or OOK_OTHER
+	unsigned int dur[OOK_FRAME_MAX_EDGES];	// HIGH/LOW durations in us, starting with HIGH
+};
+/***************************************************** OokFrameSource ***************************************************
+* HIGH/LOW durations of an encoded frame, read by the edge output loop (see ookEmitWith)
+/***********************************************************************************************************************/
+struct OokFrameSource {
+	const unsigned int *dur;				// Next HIGH duration
+	const unsigned int *end;				// End of the frame durations
+	inline void begin(const OokFrame &frame) { dur = frame.dur; end = frame.dur + frame.length; }
+	inline boolean next(unsigned int &high, unsigned int &low)
+	{
+		if (dur >= end) return false;
+		high = dur[0];
+		low = dur[1];
+		dur += 2;
+		return true;
+	}
+};
+
+/****************************************************** OokCapture ******************************************************
+* Raw capture: a pulse train of any protocol stored as a byte array in program memory (see encodeCapture). Durations 
+* are quantized to a table of at most OOK_CAPTURE_SYMBOLS values, each duration is then the 1, 2 or 4 bits index of 
+* its table value, packed MSB first. Layout:
+*	- repeats, repDly (ms), number of table values, number of durations (16 bits, LSB first, even)
+*	- table values in us (16 bits, LSB first)
+*	- packed indices of the HIGH/LOW durations, starting with HIGH
+* A 132 durations KAKU New frame (3 values, 2 bits indices) takes 5 + 6 + 33 = 44 bytes, its OokFrame 300 bytes.
+/***********************************************************************************************************************/
+#define OOK_CAPTURE_SYMBOLS   16
+#define OOK_CAPTURE_HEADER    5
+#define OOK_CAPTURE_REPEATS   0
+#define OOK_CAPTURE_REPDLY    1
+#define OOK_CAPTURE_COUNT     2
+#define OOK_CAPTURE_LENGTH    3
+// Largest difference between a duration and the table value it is quantized to (%)
+#define OOK_CAPTURE_TOLERANCE 20
+// Number of bits of a table index
+#define OOK_CAPTURE_BITS(symbols) ((symbols) <= 2 ? 1 : (symbols) <= 4 ? 2 : 4)
+/*************************************************** OokCaptureSource **************************************************
+* HIGH/LOW durations of a raw capture read from program memory one index at a time, only the table is copied to RAM
+/***********************************************************************************************************************/
+struct OokCaptureSource {
+	unsigned int table[OOK_CAPTURE_SYMBOLS];// Table values (us)
+	const byte *index;						// Next packed index byte
+	unsigned int left;						// Durations left
+	byte bits;								// Bits of an index
+	byte mask;								// Index mask
+	byte shift;								// Bits left in the current byte
+	byte current;							// Current packed index byte
+	inline void begin(const byte *capture)
+	{
+		byte symbols = pgm_read_byte(capture + OOK_CAPTURE_COUNT);
+		if (symbols > OOK_CAPTURE_SYMBOLS) symbols = 0;
+		left = symbols ? pgm_read_byte(capture + OOK_CAPTURE_LENGTH) | 
+			(pgm_read_byte(capture + OOK_CAPTURE_LENGTH + 1) << 8) : 0;
+		const byte *value = capture + OOK_CAPTURE_HEADER;
+		for (byte i = 0; i < symbols; i++, value += 2) table[i] = pgm_read_byte(value) | (pgm_read_byte(value + 1) << 8);
+		index = value;
+		bits = OOK_CAPTURE_BITS(symbols);
+		mask = (1 << bits) - 1;
+		shift = 0;
+	}
+	inline unsigned int nextDuration()
+	{
+		if (shift == 0)
+		{
+			current = pgm_read_byte(index++);
+			shift = 8;
+		}
+		shift -= bits;
+		return table[(current >> shift) & mask];
+	}
+	inline boolean next(unsigned int &high, unsigned int &low)
+	{
+		if (left < 2) return false;
+		high = nextDuration();
+		low = nextDuration();
+		left -= 2;
+		return true;
+	}
+};
+
+/***************************************************** OokProtocol ******************************************************
+* OOK protocol descriptor. All durations are in units of the OOK pulse time (_periodusec). A frame is made of:
+*	- a LOW level (leadLow), then a sync pulse (syncHigh, syncLow) when not 0
+*	- the datagram bits, each sent as one of the symbols (0, 1, float or dim), MSB or LSB first
+*	- with OOK_DIM_EXT and a dim level, the dim symbol replaces bit dimPos and dimBits dim level bits are appended
+*	- a tail pulse (tailHigh, tailLow) when not 0
+* Symbols are given as HIGH, LOW, HIGH, LOW; a 0 second HIGH makes a single pulse symbol.
+* Descriptors are located in program memory, an unused descriptor takes no memory at all.
+/***********************************************************************************************************************/
+#define OOK_SYMBOL_ZERO       0
+#define OOK_SYMBOL_ONE        1
+#define OOK_SYMBOL_FLOAT      2
+#define OOK_SYMBOL_DIM        3
+#define OOK_MSB_FIRST         0x01					// Datagram bits are sent MSB first
+#define OOK_DIM_EXT           0x02					// Protocol with a dim level extension
+struct OokProtocol {
+	byte leadLow;							// LOW level before the frame
+	byte syncHigh;							// Sync pulse before the datagram
+	byte syncLow;
+	byte tailHigh;							// Tail pulse after the datagram
+	byte tailLow;
+	byte symbol[4][4];						// 0, 1, float and dim symbols
+	byte bits;								// Number of datagram bits
+	byte flags;								// OOK_MSB_FIRST, OOK_DIM_EXT
+	byte dimPos;							// Bit replaced by the dim symbol
+	byte dimBits;							// Number of dim level bits
+};
+// KAKU New: sync 1,10; bit 0: 1,1,1,5; bit 1: 1,5,1,1; dim: 1,1,1,1; stop 1,10; 32 bits MSB first + 4 dim bits
+const OokProtocol OOK_PROTO_KAKU_NEW PROGMEM = 
+	{ 0, 1, 10, 1, 10, { {1,1,1,5}, {1,5,1,1}, {0,0,0,0}, {1,1,1,1} }, 32, OOK_MSB_FIRST|OOK_DIM_EXT, 27, 4 };
+// KAKU Old: start 3,1,3 (LOW first); bit 0: 1,3,1,3; bit 1: 3,1,1,3; 12 bits LSB first
+const OokProtocol OOK_PROTO_KAKU_OLD PROGMEM = 
+	{ 3, 1, 3, 0, 0, { {1,3,1,3}, {3,1,1,3}, {0,0,0,0}, {0,0,0,0} }, 12, 0, 0, 0 };
+// KAKU Cogex: same symbols as KAKU Old, the bit 1 acting as float
+const OokProtocol OOK_PROTO_COGEX PROGMEM = 
+	{ 3, 1, 3, 0, 0, { {1,3,1,3}, {3,1,1,3}, {0,0,0,0}, {0,0,0,0} }, 12, 0, 0, 0 };
+// PT2262 (tri-state): bit 0: 1,3,1,3; bit 1: 3,1,3,1; float: 1,3,3,1; sync 1,31 after 12 bits MSB first
+const OokProtocol OOK_PROTO_PT2262 PROGMEM = 
+	{ 0, 0, 0, 1, 31, { {1,3,1,3}, {3,1,3,1}, {1,3,3,1}, {0,0,0,0} }, 12, OOK_MSB_FIRST, 0, 0 };
+// EV1527 (learning code): preamble 1,31; bit 0: 1,3; bit 1: 3,1; 20 bits address + 4 bits data MSB first
+const OokProtocol OOK_PROTO_EV1527 PROGMEM = 
+	{ 0, 1, 31, 0, 0, { {1,3,0,0}, {3,1,0,0}, {0,0,0,0}, {0,0,0,0} }, 24, OOK_MSB_FIRST, 0, 0 };
+// HomeEasy (HE300 series): KAKU New framing without dim extension, 26 bits address, group, level, 4 bits unit
+const OokProtocol OOK_PROTO_HOMEEASY PROGMEM = 
+	{ 0, 1, 10, 1, 10, { {1,1,1,5}, {1,5,1,1}, {0,0,0,0}, {0,0,0,0} }, 32, OOK_MSB_FIRST, 0, 0 };
+
+/***************************************************** OokCommand *******************************************************
+* Queued OOK command with the timing parameters in use when it was queued
+/***********************************************************************************************************************/
+struct OokCommand {
+	unsigned long int addr;					// House address
+	unsigned int periodusec;				// OOK pulse time
+	byte repeats;							// Number of time the datagram is to be repeated
+	byte repDly;							// Delay between repeated datagrams
+	byte protocol;							// OOK_KAKU_NEW, OOK_KAKU_OLD or OOK_KAKU_COGEX
+	byte unit;								// Remote switch unit address
+	byte dimLevel;							// Remote switch dim level (New only)
+	boolean on;								// Remote switch state level
+	boolean group;							// Remote switch group command option (New only)
+};
+/**************************************************** OokBatchStats *****************************************************
+* Statistics of the last batched sending
+/***********************************************************************************************************************/
+struct OokBatchStats {
+	byte commands;							// Number of commands sent
+	unsigned int frames;					// Number of frames sent (repeats included)
+	unsigned int regReads;					// RFM69 register reads done
+	unsigned int regWrites;					// RFM69 register writes done
+	unsigned int regReadsSaved;				// Register reads saved compared to sending each command on its own
+	unsigned int regWritesSaved;			// Register writes saved compared to sending each command on its own
+};
+/************************************************** OokProtocolStats ****************************************************
+* Transmit counters of one protocol
+/***********************************************************************************************************************/
+struct OokProtocolStats {
+	unsigned long int frames;				// Frames sent
+	unsigned long int repeats;				// Frame repeats sent
+	unsigned long int txOnUsec;				// Time spent transmitting, delays between repeats included (us)
+};
+/****************************************************** OokStats ********************************************************
+* Cumulative transmit telemetry (see getStats)
+/***********************************************************************************************************************/
+struct OokStats {
+	OokProtocolStats protocols[OOK_PROTOCOLS];	// Per protocol, indexed by OOK_KAKU_... or OOK_OTHER
+	OokProtocolStats total;					// All protocols
+	unsigned long int csmaWaits[OOK_CSMA_BUCKETS];	// Clear channel waits: 0 ms, up to 1, 10, 100 ms and longer
+	unsigned long int csmaTimeouts;			// Channel accesses reaching their time limit without a clear channel
+	unsigned long int regReads;				// RFM69 register reads
+	unsigned long int regWrites;			// RFM69 register writes
+	unsigned int maxLateUsec;				// Worst edge lateness against its deadline (DIO2 backend)
+	unsigned long int fskGaps;				// OOK repeat gaps given to FSK reception (see setCoexistence)
+	unsigned long int fskReceived;			// FSK packets received in these gaps
+	unsigned long int fskMissed;			// FSK packets cut by the next repeat or lost on a full packet buffer
+	unsigned long int maxBlindMs;			// Longest OOK transmission without FSK reception when coexisting (ms)
+};
+/***************************************************** OokFskPacket *****************************************************
+* FSK packet received by the RFM69 library between two OOK repeats (see setCoexistence)
+/***********************************************************************************************************************/
+struct OokFskPacket {
+	byte senderId;							// Sender node address
+	byte targetId;							// Target node address
+	byte dataLen;							// Number of data bytes
+	boolean ackRequested;					// The sender requested an ACK (not sent, the sender retries)
+	int rssi;								// RSSI of the packet (dBm)
+	byte data[RF69_MAX_DATA_LEN];			// Data bytes
+};
+/****************************************************** OokEnergy *******************************************************
+* Transmit time and estimated RFM69 charge of the last sending (see lastEnergy)
+/***********************************************************************************************************************/
+struct OokEnergy {
+	unsigned long int txOnUsec;				// Time in transmit mode, carrier on or off (us)
+	unsigned long int carrierUsec;			// Time the carrier was on (HIGH levels, us)
+	unsigned long int standbyUsec;			// Time in standby between repeats (low power mode, us)
+	unsigned long int rxUsec;				// Time receiving FSK between repeats (coexistence, us)
+	unsigned long int sleepUsec;			// Time given to the MCU sleep function (us)
+	unsigned long int chargeUc;				// Estimated RFM69 charge from the supply currents (uC)
+};
+// MCU sleep function of the low power mode: sleeps at most usec, woken by a timer. micros() must keep counting.
+typedef void (*OokSleepFunction)(unsigned long int usec);
+/*************************************************** OokTraceEntry ******************************************************
+* Trace event recorded when RFM69OOK_DEBUG is set, fields meaning depends on the event:
+*	- OOK_TRACE_ENCODE: cmd datagram, param logical unit | dim level << 8, outcome on | group << 1
+*	- OOK_TRACE_SEND: cmd period (us) | repeats << 16 | repDly << 24, param durations, outcome backend
+*	- OOK_TRACE_ACCESS: param wait (ms), outcome OOK_CHANNEL_...
+/***********************************************************************************************************************/
+struct OokTraceEntry {
+	unsigned long int time;					// Event time (micros)
+	unsigned long int cmd;					// Command word
+	unsigned int param;						// Parameters
+	byte event;								// OOK_TRACE_...
+	byte protocol;							// OOK_KAKU_... or OOK_OTHER
+	byte outcome;							// Outcome
+};
+/*************************************************** OokCalibration *****************************************************
+* Edge timing measured by calibrate() on the running board
+/***********************************************************************************************************************/
+struct OokCalibration {
+	unsigned int resolutionUsec;			// micros() resolution
+	unsigned int pollUsec;					// Cost of one deadline poll
+	unsigned int writeUsec;					// digitalWrite processing delay, used as edge lead time
+	unsigned int edgeErrorUsec;				// Worst-case edge error
+	unsigned int edgeErrorPermil;			// Worst-case edge error per thousand of the OOK pulse time
+};
+/**************************************************** OokEdgeStats ******************************************************
+* Edge output cost and timing spread measured by measureEdges()
+/***********************************************************************************************************************/
+struct OokEdgeStats {
+	unsigned int edgeCostNs;				// Average processing time of one edge output (ns)
+	unsigned int maxLateUsec;				// Worst edge lateness against its deadline
+	unsigned int jitterUsec;				// Spread between the earliest and the latest edge
+};
+/*************************************************** OokEdgeErrors ****************************************************
+* Edge timing errors of a frame measured by dryRun(), against the nominal edge times relative to the first edge
+/***********************************************************************************************************************/
+struct OokEdgeErrors {
+	unsigned int edges;						// Number of edges output
+	unsigned int maxEarlyUsec;				// Earliest edge against its nominal time
+	unsigned int maxLateUsec;				// Latest edge against its nominal time
+	unsigned int meanUsec;					// Mean absolute edge error
+};
+/***************************************************** OokMessage *****************************************************
+* Message decoded by RFM69OOKReceiver, with the fields taken by the send functions of the same protocol
+/***********************************************************************************************************************/
+struct OokMessage {
+	byte protocol;							// OOK_KAKU_NEW, OOK_KAKU_OLD or OOK_KAKU_COGEX
+	unsigned long int addr;					// House address (Old: 'A' to 'P')
+	byte unit;								// Remote switch unit address (0 for a group command)
+	boolean on;								// Remote switch state level
+	boolean group;							// Remote switch group command option (New only)
+	byte dimLevel;							// Remote switch dim level, 0 for none (New only)
+	unsigned long int data;					// Received datagram bits
+	unsigned int periodusec;				// OOK pulse time measured on the sync pulse
+	byte repeats;							// Number of identical frames received
+};
+/***************************************************** OokRxStats *****************************************************
+* Receiver counters
+/***********************************************************************************************************************/
+struct OokRxStats {
+	unsigned long int edges;				// Edges processed
+	unsigned int overruns;					// Edges lost on a full ring
+	unsigned int frames;					// Frames decoded (repeats included)
+};
+/**************************************************** OokRxDecoder ****************************************************
+* Streaming decoder state of one protocol descriptor, fed with HIGH/LOW pulses
+/***********************************************************************************************************************/
+struct OokRxDecoder {
+	OokProtocol p;							// Protocol descriptor copied from program memory
+	unsigned int period;					// OOK pulse time measured on the sync pulse, 0 while waiting for a sync
+	unsigned int high;						// First pulse of a two pulses symbol
+	unsigned int low;
+	boolean half;							// First pulse of the symbol received
+	byte symbols;							// Symbols received
+	boolean dimmed;							// Dim symbol received
+	byte dimLevel;							// Dim level bits received
+	unsigned long int data;					// Datagram bits received
+};
+/******************************************************* OokPin *******************************************************
+* OOK data pin output through digitalWrite (pin resolved at run time)
+/***********************************************************************************************************************/
+struct OokPin {
+	byte pin;
+	inline void high() { digitalWrite(pin, HIGH); }
+	inline void low() { digitalWrite(pin, LOW); }
+};
+/***************************************************** OokFastPin *****************************************************
+* OOK data pin output resolved at compile time. The RF69_OOK_PIN of the known AVR processors is written directly to
+* its port register (single instruction), any other pin falls back to digitalWrite.
+/***********************************************************************************************************************/
+template <uint8_t PIN> struct OokFastPin {
+	static const boolean direct = false;
+	inline void high() { digitalWrite(PIN, HIGH); }
+	inline void low() { digitalWrite(PIN, LOW); }
+};
+#if defined(RF69_OOK_PORT)
+template <> struct OokFastPin<RF69_OOK_PIN> {
+	static const boolean direct = true;
+	inline void high() { RF69_OOK_PORT |= _BV(RF69_OOK_BIT); }
+	inline void low() { RF69_OOK_PORT &= ~_BV(RF69_OOK_BIT); }
+};
+#endif
+/*************************************************** OokEdgeRecorder **************************************************
+* Pin output wrapper recording the error of each edge against its nominal time in the frame (see dryRun)
+/***********************************************************************************************************************/
+template <class PIN> struct OokEdgeRecorder {
+	struct State {
+		const unsigned int *dur;			// Next HIGH/LOW durations of the frame
+		unsigned long int pos;				// Nominal time of the next HIGH edge
+		unsigned long int start;			// Time of the frame start
+		unsigned long int sumAbs;			// Sum of the absolute edge errors
+		OokEdgeErrors errors;
+	};
+	PIN pin;
+	State *state;
+	inline void high() { pin.high(); record(state->pos); }
+	inline void low() 
+	{
+		pin.low();
+		record(state->pos + state->dur[0] - OOK_HIGH_TRIM(state->dur[0]));
+		state->pos += state->dur[0] + state->dur[1];
+		state->dur += 2;
+	}
+	void record(unsigned long int nominal)
+	{
+		unsigned long int now = micros();
+		if (state->errors.edges++ == 0) state->start = now - nominal;
+		long error = (long)(now - state->start - nominal);
+		if (error < 0 && (unsigned int)(-error) > state->errors.maxEarlyUsec) state->errors.maxEarlyUsec = -error;
+		if (error > 0 && (unsigned int)error > state->errors.maxLateUsec) state->errors.maxLateUsec = error;
+		state->sumAbs += error < 0 ? -error : error;
+	}
+};
+
+// Interrupt service functions must be located in RAM on the ESP8266
+#if defined(ESP8266)
+	#define OOK_ISR_ATTR ICACHE_RAM_ATTR
+#else
+	#define OOK_ISR_ATTR
+#endif
+/****************************************************** OokTimer ********************************************************
+* Hardware timer abstraction used by the asynchronous transmitter. start() schedules the next compare event usec after
+* the previous one (after begin() the reference is the current time); the backend then calls the attached function.
+/***********************************************************************************************************************/
+class OokTimer {
+public:
+	// Attach the function called on each compare event and take the current time as reference
+	virtual void begin(void (*isr)(void)) = 0;
+	// Schedule the next compare event usec after the previous one
+	virtual void start(unsigned long usec) = 0;
+	// Stop the compare events
+	virtual void stop() = 0;
+};
+#if defined(__AVR__)
+// AVR Timer1 compare A backend (prescaler 8), not usable together with other Timer1 users like the Servo library
+class OokTimerAvr1 : public OokTimer {
+public:
+	void begin(void (*isr)(void));
+	void start(unsigned long usec);
+	void stop();
+	static void (*volatile isr)(void);		// Function attached to the compare event
+	static volatile unsigned long pending;	// Timer ticks still to wait for intervals longer than one compare period
+};
+#elif defined(ESP8266)
+// ESP8266 timer1 backend (divider 16, 5 ticks per us)
+class OokTimerEsp8266 : public OokTimer {
+public:
+	void begin(void (*isr)(void));
+	void start(unsigned long usec);
+	void stop();
+};
+#endif
+// Virtual clock backend, compare events are fired by advance() (host simulation)
+class OokVirtualTimer : public OokTimer {
+public:
+	OokVirtualTimer();
+	void begin(void (*isr)(void));
+	void start(unsigned long usec);
+	void stop();
+	// Advance the virtual clock, firing every compare event falling in the interval
+	void advance(unsigned long usec);
+	// Current virtual time in us
+	unsigned long now();
+private:
+	void (*_isr)(void);
+	unsigned long _now;						// Virtual time
+	unsigned long _deadline;				// Time of the next compare event
+	boolean _armed;							// A compare event is scheduled
+};
+
+class RFM69OOK;
+class RFM69OOKMulti;
+// Function called when an asynchronous sending is terminated
+typedef void (*OokDoneCallback)(RFM69OOK &ook);
 
 class RFM69OOK {
+	friend class RFM69OOKMulti;
+	friend class RFM69OOKScene;
 public: 
     // Define a RFM69OOK Class with default parameters
     RFM69OOK();                      		
@@ -69,8 +622,121 @@ public:
     void sendKakuOld(RFM69 &radio, char addr, byte unit, byte on);
     // Send OOK Kaku datagram using the Cogex protocol
     void sendKakuCogex(RFM69 &radio, byte addr, byte unit, byte on);   
-private:
+    // Encode OOK Kaku datagram using the New protocol
+    void encodeKakuNew(OokFrame &frame, unsigned long int addr, byte unit, boolean on, boolean group, byte dimLevel);
+    // Encode OOK Kaku datagram using the Old protocol
+    void encodeKakuOld(OokFrame &frame, char addr, byte unit, byte on);
+    // Encode OOK Kaku datagram using the Cogex protocol
+    void encodeKakuCogex(OokFrame &frame, byte addr, byte unit, byte on);
+    // Send a datagram according to a protocol descriptor
+    void send(RFM69 &radio, const OokProtocol &protocol, unsigned long int data, unsigned long int floatMask = 0, 
+    	byte dimLevel = 0);
+    // Encode a datagram according to a protocol descriptor
+    void encode(OokFrame &frame, const OokProtocol &protocol, unsigned long int data, unsigned long int floatMask = 0, 
+    	byte dimLevel = 0);
+    // Send a previously encoded OOK frame
+    void sendFrame(RFM69 &radio, const OokFrame &frame);
+    // Send a raw capture located in program memory
+    void sendCapture(RFM69 &radio, const byte *capture);
+    // Encode recorded edge times (us, first edge rising) into a raw capture, returns its size (0 if it does not fit)
+    unsigned int encodeCapture(byte *capture, unsigned int size, const unsigned long int *edges, unsigned int count);
+    // Select the timer used for asynchronous sending (default is the platform timer)
+    void setOokTimer(OokTimer &timer);
+    // Set the function called when an asynchronous sending is terminated
+    void onSendDone(OokDoneCallback callback);
+    // Start sending OOK Kaku datagram using the New protocol without blocking
+    boolean beginSendKakuNew(RFM69 &radio, unsigned long int addr, byte unit, boolean on, boolean group, byte dimLevel);
+    // Start sending OOK Kaku datagram using the Old protocol without blocking
+    boolean beginSendKakuOld(RFM69 &radio, char addr, byte unit, byte on);
+    // Start sending OOK Kaku datagram using the Cogex protocol without blocking
+    boolean beginSendKakuCogex(RFM69 &radio, byte addr, byte unit, byte on);
+    // Start sending an encoded OOK frame without blocking (the frame must stay valid until the sending is terminated)
+    boolean beginSendFrame(RFM69 &radio, const OokFrame &frame);
+    // Check for an asynchronous sending in progress, terminate it when the last repeat is sent
+    boolean isBusy();
+    // Queue an OOK Kaku New command for a batched sending
+    boolean enqueueKakuNew(unsigned long int addr, byte unit, boolean on, boolean group, byte dimLevel);
+    // Queue an OOK Kaku Old command for a batched sending
+    boolean enqueueKakuOld(char addr, byte unit, byte on);
+    // Queue an OOK Kaku Cogex command for a batched sending
+    boolean enqueueKakuCogex(byte addr, byte unit, byte on);
+    // Number of queued commands
+    byte queued();
+    // Drop all queued commands
+    void clearQueue();
+    // Send all queued commands in one batch
+    void flush(RFM69 &radio);
+    // Statistics of the last batched sending
+    const OokBatchStats &getBatchStats();
+    // Enable or disable the RFM69 register shadow cache
+    void setRegCache(boolean enable);
+    // Forget the cached RFM69 register values (to call after accessing these registers through the RFM69 instance)
+    void invalidateRegCache();
+    // Measure the edge output processing delay and report the worst-case edge error
+    const OokCalibration &calibrate();
+    // Measure the edge output cost and timing spread
+    virtual OokEdgeStats measureEdges();
+    // Total air time of an encoded frame with its repeats and delays (us)
+    unsigned long int airtime(const OokFrame &frame);
+    // Output an encoded frame once on the data pin without transmitting and measure its edge errors
+    virtual OokEdgeErrors dryRun(const OokFrame &frame);
+    // Cumulative transmit telemetry (all zero when compiled out with OOK_STATS 0)
+    const OokStats &getStats();
+    // Clear the transmit telemetry
+    void resetStats();
+    // Select the transmit backend (OOK_BACKEND_DIO2 or OOK_BACKEND_FIFO)
+    void setOokBackend(byte backend);
+    // Print then forget the recorded trace events, returns the number of printed events
+    static byte dumpTrace(Stream &out);
+    // Receive FSK packets between OOK repeats, the FSK blind window being limited to maxBlindMs (0 to disable)
+    void setCoexistence(unsigned int maxBlindMs, byte listenMs = OOK_FSK_LISTEN_MS);
+    // Check for a FSK packet received during an OOK sending
+    boolean fskReceiveDone();
+    // Put the RFM69 in standby and the MCU to sleep during the repeat gaps of the DIO2 sendings
+    void setLowPower(boolean enable, OokSleepFunction sleep = NULL);
+    // Set the RFM69 supply currents used by the charge estimation (uA)
+    void setSupplyCurrents(unsigned long int carrierUa, unsigned long int txIdleUa, 
+		unsigned long int standbyUa = OOK_STANDBY_UA, unsigned long int rxUa = OOK_RX_UA);
+    // Transmit time and estimated charge of the last sending (all zero when compiled out with OOK_STATS 0)
+    const OokEnergy &lastEnergy();
+    // Last FSK packet reported by fskReceiveDone
+    const OokFskPacket &getFskPacket();
+    // Set the clear channel RSSI threshold (dBm, 0 for the RFM69 canSend test), access time limit and busy policy
+    void setChannelAccess(int rssiThreshold, unsigned int limitMs = RF69_CSMA_LIMIT_MS, byte policy = OOK_CSMA_FORCE);
+    // Set the random backoff range between two busy RSSI samples (ms)
+    void setBackoff(byte minMs, byte maxMs);
+    // Sample the channel without blocking, returns OOK_CHANNEL_BUSY until the channel access is terminated
+    byte channelAccess(RFM69 &radio);
+    // Result of the last terminated channel access
+    byte lastChannelAccess();
+protected:
     byte _ookDataPin;						// ATMEGA328 - RFM69 OOK Data port
+	unsigned int _edgeLead;					// Time an edge is output ahead of its deadline (us)
+#if OOK_STATS
+	unsigned int _emitLateUsec;				// Worst edge lateness of the frames output since the last reset
+#endif
+	// Output an encoded frame to the RFM69 DIO2 pin
+	virtual void ookEmitFrame(const OokFrame &frame);
+	// Output an encoded frame with the given pin output
+	template <class PIN> void ookEmitFrameWith(const OokFrame &frame, PIN pin);
+	// Output a raw capture located in program memory to the RFM69 DIO2 pin
+	virtual void ookEmitCapture(const byte *capture);
+	// Output the durations of a source with the given pin output
+	template <class PIN, class SOURCE> void ookEmitWith(SOURCE &source, PIN pin);
+	// Measure the edge output cost and timing spread with the given pin output
+	template <class PIN> OokEdgeStats ookMeasureEdgesWith(PIN pin);
+	// Output an encoded frame with the given pin output and measure its edge errors
+	template <class PIN> OokEdgeErrors ookDryRunWith(const OokFrame &frame, PIN pin);
+	// Record the lateness of an output edge (nothing when compiled out)
+	inline void ookEmitLate(long late)
+	{
+#if OOK_STATS
+		if ((unsigned long)late > _emitLateUsec) _emitLateUsec = late;
+#else
+		(void) late;
+#endif
+	}
+private:
 	byte _repeats;							// Number of time a datagram is to be repeated
 	byte _repDly;							// Delay between repeated datagrams
 	unsigned int _periodusec;				// OOK pulse time for OOK SAW devices	
@@ -78,17 +744,532 @@ private:
 	int _modulation; 						// Used to record the previous Modulation Mode
 	int _bitRateMsb; 						// Used to record the previous value of the BitRate MSB
  	int _bitRateLsb;						// Used to record the previous value of the BitRate LSB
-	// New Kaku datagram output to RFM69 
-    void ookNewKakuRfmPulse(int l1, int l2);
-   	// Old Kaku datagram output to RFM69 
-    void ookOldKakuRfmPulse(int on, int off);
-    // Cogex Kaku datagram output to RFM69 
-    void ookCogexRfmPulse(int on, int off);
-    // Print OOK settings informations
-	void printOokInfos (unsigned long int addr, unsigned long int unit, boolean on, boolean group, byte dimLevel, int cmd);
-	// Prepare RFM69 registers and media before sending an OOK frame
-	void ookPreSend (RFM69 &radio);
+	OokTimer *_timer;						// Timer used for asynchronous sending
+	OokDoneCallback _doneCallback;			// Function called when an asynchronous sending is terminated
+	RFM69 *_txRadio;						// RFM69 instance of the asynchronous sending
+	const OokFrame *_txFrame;				// Frame of the asynchronous sending
+	volatile byte _txIndex;					// Index of the next duration to output
+	volatile byte _txRepeat;				// Number of repeats already sent
+	volatile byte _txState;					// Asynchronous sending state (idle, channel access, running, done)
+	static RFM69OOK *_asyncOwner;			// Instance owning the timer
+	OokCommand _queue[OOK_QUEUE_SIZE];		// Commands queued for a batched sending
+	byte _queueLength;						// Number of queued commands
+	OokBatchStats _batchStats;				// Statistics of the last batched sending
+	unsigned long int _regReads;			// Number of RFM69 register reads
+	unsigned long int _regWrites;			// Number of RFM69 register writes
+	boolean _regCacheOn;					// Register shadow cache enabled
+	byte _regValid;							// Bit mask of the valid shadow registers
+	byte _regShadow[5];						// Last known value of PACKETCONFIG2, OPMODE, DATAMODUL, BITRATEMSB/LSB
+	OokCalibration _calibration;			// Last calibration results
+	byte _txBackend;						// Selected transmit backend
+	boolean _fifoActive;					// Registers prepared for the FIFO backend
+	byte _fifoSaved[7];						// Packet engine registers saved by ookPreSend
+	byte _fifoLevel;						// Level of the current chip run
+	unsigned int _fifoChips;				// Chips left in the current run
+	boolean _fifoEnd;						// Last chip loaded in the FIFO
+	unsigned long int _fifoLastBusy;		// Last time the FIFO was seen not empty
+	int _rssiThreshold;						// Clear channel RSSI threshold (dBm), 0 to use the RFM69 canSend test
+	unsigned int _accessLimitMs;			// Longest channel access before the busy policy is applied (ms)
+	byte _accessPolicy;						// Busy channel policy (OOK_CSMA_...)
+	byte _backoffMin;						// Random backoff range between two busy RSSI samples (ms)
+	byte _backoffMax;
+	byte _accessState;						// Channel access in progress (OOK_CHANNEL_BUSY) or its last result
+	unsigned long int _accessStart;			// Start time of the channel access
+	unsigned long int _accessNext;			// Time of the next RSSI sample
+	boolean _channelGranted;				// Clear channel result not used yet by a sending
+	unsigned long int _grantTime;			// Time of the clear channel result
+	unsigned int _coexBlindMs;				// Longest FSK blind window, 0 without coexistence
+	byte _coexListenMs;						// Shortest FSK reception time between two OOK repeats
+	unsigned long int _blindStart;			// Start time of the current FSK blind window
+	boolean _fskListen;						// FSK reception done during the sending, left receiving afterwards
+#if OOK_FSK_PACKETS
+	OokFskPacket _fskPackets[OOK_FSK_PACKETS];	// Received FSK packets
+	byte _fskHead;							// Index of the oldest received packet
+	byte _fskCount;							// Number of received packets not reported yet
+	byte _fskCurrent;						// Index of the packet reported by fskReceiveDone
+	// Receive FSK packets for a gap between two OOK repeats
+	void ookFskGap(RFM69 &radio, unsigned int gapMs);
+#endif
+	// Wait the repeat delay, or give it to FSK reception to bound the FSK blind window
+	void ookRepeatGap(RFM69 &radio, byte repDly, unsigned long int frameMs, boolean last);
+	boolean _lowPower;						// RFM69 in standby and MCU sleeping during the repeat gaps
+	OokSleepFunction _sleep;				// MCU sleep function, NULL to wait with delay
+	unsigned long int _emitEnd;				// End time of the last LOW level output (us)
+	// Put the RFM69 in standby until the end of a repeat gap
+	void ookStandbyGap(RFM69 &radio, unsigned long int end);
+#if OOK_STATS
+	OokEnergy _energy;						// Energy of the current or last sending
+	unsigned long int _emitCarrierUsec;		// Carrier on time output since ookPreSend
+	unsigned long int _txModeStart;			// Time the RFM69 was set in transmit mode by ookPreSend
+	unsigned long int _carrierUa;			// Supply currents of the charge estimation
+	unsigned long int _txIdleUa;
+	unsigned long int _standbyUa;
+	unsigned long int _rxUa;
+	// Terminate the energy report of the sending
+	void ookEnergyEnd();
+	// Carrier on time of an encoded frame and its repeats (us)
+	static unsigned long int ookFrameCarrier(const OokFrame &frame);
+	// Charge drawn by a current during a time (uC)
+	static unsigned long int ookCharge(unsigned long int usec, unsigned long int ua);
+#endif
+	boolean _traceMuted;					// No trace events while RFM69OOKScene encodes frames to plan a scene
+#if OOK_TRACE_SIZE
+	static OokTraceEntry _trace[OOK_TRACE_SIZE];	// Trace ring, shared by all instances
+	static byte _traceHead;					// Index of the oldest event
+	static byte _traceCount;				// Number of events in the ring
+	static unsigned int _traceLost;			// Events overwritten before being printed
+	// Add an event to the trace ring
+	static void ookTraceAdd(byte event, byte protocol, unsigned long int cmd, unsigned int param, byte outcome);
+#endif
+	// Record a trace event when RFM69OOK_DEBUG is set (nothing when compiled out)
+	inline void ookTrace(byte event, byte protocol, unsigned long int cmd, unsigned int param, byte outcome)
+	{
+#if OOK_TRACE_SIZE
+		if (RFM69OOK_DEBUG && !_traceMuted) ookTraceAdd(event, protocol, cmd, param, outcome);
+#else
+		(void) event, (void) protocol, (void) cmd, (void) param, (void) outcome;
+#endif
+	}
+	// Record the start of a frame sending
+	inline void ookTraceSend(byte protocol, unsigned int periodusec, byte repeats, byte repDly, unsigned int length)
+	{
+		ookTrace(OOK_TRACE_SEND, protocol, periodusec | (unsigned long int)repeats << 16 | 
+			(unsigned long int)repDly << 24, length, _fifoActive ? OOK_BACKEND_FIFO : OOK_BACKEND_DIO2);
+	}
+#if OOK_STATS
+	OokStats _stats;						// Transmit telemetry
+	unsigned long int _txStart;				// Start time of the asynchronous sending
+	volatile unsigned long int _txEnd;		// End time of the asynchronous sending
+	// Count a sent frame
+	void ookStatsFrame(byte protocol, byte repeats, unsigned long int txOnUsec);
+	// Count a clear channel wait
+	void ookStatsCsma(unsigned long int waitMs, boolean timeout);
+#endif
+	// Terminate the channel access with a result
+	byte ookAccessEnd(byte result);
+	// Wait for a clear channel before a sending, returns false if the sending is dropped or deferred
+	boolean ookWaitChannel(RFM69 &radio);
+	// Start the asynchronous sending once the channel is clear
+	boolean ookAsyncStart();
+	// Send an encoded frame for each repeat with the prepared backend
+	void ookSendRepeats(RFM69 &radio, const OokFrame &frame);
+	// Prepare the bit rate and FIFO and start transmitting
+	boolean ookFifoStart(RFM69 &radio, const OokFrame &frame);
+	// Refill the FIFO, returns false once the frame is sent
+	boolean ookFifoService(RFM69 &radio);
+	// Build the next byte of chips
+	boolean ookFifoNextByte(byte &value);
+	// Load the next run of identical chips
+	boolean ookFifoNextRun();
+	// Reserve a queue entry
+	OokCommand *ookQueueAdd(byte protocol);
+	// Check that no asynchronous sending is using the timer
+	static boolean ookAsyncReady();
+	// Timer compare event handler
+	static void ookTimerIsr();
+	// Output the next edge of the asynchronous sending
+	void ookTimerTick();
+	// Initialise a frame with the current timing parameters
+	void ookFrameBegin(OokFrame &frame);
+	// Append a HIGH/LOW pulse to a frame
+	void ookFrameAdd(OokFrame &frame, unsigned int high, unsigned int low);
+	// Append the pulses of a descriptor symbol
+	void ookAddSymbol(OokFrame &frame, const byte *symbol);
+	// Output an encoded frame for each repeat
+	void ookEmitRepeats(RFM69 &radio, const OokFrame &frame);
+	// Duration between two recorded edges
+	static unsigned int ookCaptureDuration(const unsigned long int *edges, unsigned int count, unsigned int i);
+	// Prepare RFM69 registers and media before sending an OOK frame, returns false if the channel is not granted
+	boolean ookPreSend (RFM69 &radio);
 	// Restore RFM69 register after sending an OOK frame
 	void ookPostSend (RFM69 &radio);
+	// Read a RFM69 register
+	byte ookReadReg(RFM69 &radio, byte addr);
+	// Write a RFM69 register
+	void ookWriteReg(RFM69 &radio, byte addr, byte value);
+};
+
+/**************************************************** ookEmitFrameWith *************************************************
+* Function:  	Output an encoded frame to the RFM69 DIO2 pin (see ookEmitWith)
+* Parameters: 	
+*				Encoded frame
+*				Pin output
+/***********************************************************************************************************************/
+template <class PIN> void RFM69OOK::ookEmitFrameWith(const OokFrame &frame, PIN pin)
+{
+	OokFrameSource source;
+	source.begin(frame);
+	ookEmitWith(source, pin);
+}
+/****************************************************** ookEmitWith ***************************************************
+* Function:  	Output the HIGH/LOW durations of a source to the RFM69 DIO2 pin, the next durations are read right 
+*				after an edge is written. Each edge is scheduled against an absolute micros() deadline so that timing 
+*				errors do not add up over the frame; the pin is written _edgeLead us ahead to cover the output 
+*				processing delay. HIGH levels end OOK_HIGH_TRIM us early (RFM69 OOK output compensation).
+* Parameters: 	
+*				Duration source (OokFrameSource, OokCaptureSource)
+*				Pin output
+/***********************************************************************************************************************/
+template <class PIN, class SOURCE> void RFM69OOK::ookEmitWith(SOURCE &source, PIN pin)
+{
+	unsigned int high, low;
+	unsigned long int deadline = micros() + _edgeLead;
+	long late;											// Time the deadline was passed when noticed
+	while (source.next(high, low))
+	{
+		if (high != 0)									// Skipped for the Start bit of Old Kaku and Cogex
+		{
+			while ((late = (long)(micros() + _edgeLead - deadline)) < 0);
+			pin.high();
+			ookEmitLate(late);
+			deadline += high;
+#if OOK_STATS
+			_emitCarrierUsec += high;
+#endif
+			while ((late = (long)(micros() + _edgeLead + OOK_HIGH_TRIM(high) - deadline)) < 0);
+		}
+		else while ((late = (long)(micros() + _edgeLead - deadline)) < 0);
+		pin.low();
+		ookEmitLate(late);
+		deadline += low;
+	}
+	_emitEnd = deadline;
+	if (!_lowPower) while ((long)(micros() - deadline) < 0);	// Hold the last LOW level, else left to ookRepeatGap
+}
+/************************************************** ookMeasureEdgesWith ************************************************
+* Function:  	Measure the average cost of an edge output, then the lateness of edges scheduled against deadlines.
+*				Only LOW levels are written so that nothing is transmitted.
+* Parameters: 	Pin output
+/***********************************************************************************************************************/
+template <class PIN> OokEdgeStats RFM69OOK::ookMeasureEdgesWith(PIN pin)
+{
+	const unsigned int samples = 256;
+	const unsigned int step = 100;						// Time between scheduled edges (us)
+	OokEdgeStats stats;
+	unsigned long int start = micros();
+	for (unsigned int i = 0; i < samples; i++) pin.low();
+	stats.edgeCostNs = (micros() - start) * 1000UL / samples;
+	unsigned int earliest = 0xFFFF;
+	unsigned int latest = 0;
+	unsigned long int deadline = micros() + step;
+	for (byte i = 0; i < 32; i++)
+	{
+		while ((long)(micros() - deadline) < 0);
+		pin.low();
+		unsigned int late = micros() - deadline;
+		if (late < earliest) earliest = late;
+		if (late > latest) latest = late;
+		deadline += step;
+	}
+	stats.maxLateUsec = latest;
+	stats.jitterUsec = latest - earliest;
+	return stats;
+}
+/***************************************************** ookDryRunWith **************************************************
+* Function:  	Output an encoded frame once with the given pin output through an edge recorder
+* Parameters: 	
+*				Encoded frame
+*				Pin output
+/***********************************************************************************************************************/
+template <class PIN> OokEdgeErrors RFM69OOK::ookDryRunWith(const OokFrame &frame, PIN pin)
+{
+	typename OokEdgeRecorder<PIN>::State state;
+	memset(&state, 0, sizeof(state));
+	state.dur = frame.dur;
+	OokEdgeRecorder<PIN> recorder;
+	recorder.pin = pin;
+	recorder.state = &state;
+	ookEmitFrameWith(frame, recorder);
+	if (state.errors.edges) state.errors.meanUsec = state.sumAbs / state.errors.edges;
+	return state.errors;
+}
+
+/**************************************************** RFM69OOKFast *****************************************************
+* RFM69OOK variant with the OOK data pin resolved at compile time (see OokFastPin). The pin is given as template 
+* parameter and must not be changed with setOokPin.
+* Example:	RFM69OOKFast<RF69_OOK_PIN> switchKaku;
+/***********************************************************************************************************************/
+template <uint8_t PIN> class RFM69OOKFast : public RFM69OOK {
+public:
+	// Define a RFM69OOKFast Class with default parameters
+	RFM69OOKFast() : RFM69OOK(PIN, 300, 10, 20) {}
+	// Define a RFM69OOKFast Class with individual parameters
+	RFM69OOKFast(unsigned int periodusec, byte repeats, byte repDly) : RFM69OOK(PIN, periodusec, repeats, repDly) {}
+	// Measure the edge output cost and timing spread
+	OokEdgeStats measureEdges() { return ookMeasureEdgesWith(OokFastPin<PIN>()); }
+	// Output an encoded frame once without transmitting and measure its edge errors
+	OokEdgeErrors dryRun(const OokFrame &frame) { return ookDryRunWith(frame, OokFastPin<PIN>()); }
+protected:
+	void ookEmitFrame(const OokFrame &frame) { ookEmitFrameWith(frame, OokFastPin<PIN>()); }
+	void ookEmitCapture(const byte *capture)
+	{
+		OokCaptureSource source;
+		source.begin(capture);
+		ookEmitWith(source, OokFastPin<PIN>());
+	}
+};
+
+/***************************************************** OokChannel *****************************************************
+* Transmitter of RFM69OOKMulti with the position of its next edge
+/***********************************************************************************************************************/
+struct OokChannel {
+	RFM69OOK *ook;							// RFM69OOK instance (data pin and saved registers)
+	RFM69 *radio;							// RFM69 radio instance
+	const OokFrame *frame;					// Frame to send
+	unsigned long int pos;					// Start time of the current HIGH/LOW pulse
+	byte index;								// Index of the HIGH duration of the current pulse
+	byte repeat;							// Repeats already sent
+	boolean low;							// The LOW edge of the pulse is the next one
+	boolean done;							// Last repeat sent
+	boolean granted;						// Channel access granted, the RFM69 is prepared
+};
+/**************************************************** RFM69OOKMulti ****************************************************
+* Multi-channel transmitter: one frame per (RFM69OOK, RFM69) pair is sent at the same time. All RFM69 are prepared 
+* together, then the edges of all frames are output in time order from one merged schedule, so that the sending takes 
+* about the time of the longest frame. Each RFM69OOK instance must have its own data pin and the DIO2 backend.
+* Example:	multi.add(floor1, radio1, frame1); multi.add(floor2, radio2, frame2); multi.send();
+/***********************************************************************************************************************/
+class RFM69OOKMulti {
+public:
+	// Define a RFM69OOKMulti Class without channels
+	RFM69OOKMulti();
+	// Add a frame to send with a RFM69OOK instance and its RFM69 (the frame must stay valid until send)
+	boolean add(RFM69OOK &ook, RFM69 &radio, const OokFrame &frame);
+	// Number of added channels
+	byte channels();
+	// Remove all channels
+	void clear();
+	// Send the frames of all channels together, then remove the channels
+	void send();
+private:
+	OokChannel _channels[OOK_MULTI_CHANNELS];	// Added channels
+	byte _count;							// Number of added channels
+	// Time of the next edge of a channel
+	unsigned long int ookMultiEdgeTime(const OokChannel &channel);
+	// Move a channel to its next edge
+	void ookMultiAdvance(OokChannel &channel);
+};
+
+/****************************************************** OokDevice *****************************************************
+* Remote switch known by RFM69OOKScene: its last commanded state and its requested state in the current scene
+/***********************************************************************************************************************/
+struct OokDevice {
+	unsigned long int addr;					// House address
+	byte protocol;							// OOK_KAKU_NEW, OOK_KAKU_OLD or OOK_KAKU_COGEX
+	byte unit;								// Remote switch unit address
+	boolean known;							// Last commanded state known
+	boolean on;								// Last commanded state level
+	byte dimLevel;							// Last commanded dim level
+	unsigned long int time;					// Time of the last command (ms)
+	boolean target;							// State requested by the current scene
+	boolean targetOn;
+	byte targetDim;
+};
+/**************************************************** OokScenePlan ****************************************************
+* Commands chosen by RFM69OOKScene for a scene, in sending order
+/***********************************************************************************************************************/
+struct OokScenePlan {
+	byte commands;							// Number of planned commands
+	byte groups;							// Group commands among them
+	byte skipped;							// Requested devices already in their state
+	unsigned long int airtimeUsec;			// Air time of the planned commands
+	unsigned long int unitAirtimeUsec;		// Air time of one unit command per requested device
+	OokCommand command[OOK_SCENE_DEVICES];	// Planned commands
+};
+/**************************************************** RFM69OOKScene ****************************************************
+* Scene compiler: the requested on/off/dim states of a set of devices are turned into the shortest list of commands.
+*	- a device already commanded to its requested state within the refresh TTL is skipped
+*	- the devices of a KAKU New house are switched by one group command, followed by the units differing from it,
+*	  when this takes less commands. Every unit of the house must have been added (addDevice or set) and have a 
+*	  requested or a known state, since a group command switches all of them.
+* Example:	scene.set(OOK_KAKU_NEW, 1332798, 1, true); scene.set(OOK_KAKU_OLD, 'D', 2, false); scene.send(ook, radio);
+/***********************************************************************************************************************/
+class RFM69OOKScene {
+public:
+	// Define a RFM69OOKScene Class without devices
+	RFM69OOKScene();
+	// Declare a device, to be done for every unit of a house switched by group commands
+	boolean addDevice(byte protocol, unsigned long int addr, byte unit);
+	// Request a device state in the current scene (the device is added if unknown)
+	boolean set(byte protocol, unsigned long int addr, byte unit, boolean on, byte dimLevel = 0);
+	// Drop the requested states of the current scene
+	void clearScene();
+	// Time a commanded state is trusted before being sent again (ms)
+	void setRefreshTtl(unsigned long int ttl);
+	// Forget the commanded states (devices switched by other means)
+	void invalidate();
+	// Plan the commands of the current scene with the timing parameters of a RFM69OOK instance
+	const OokScenePlan &compile(RFM69OOK &ook);
+	// Plan and send the current scene in one batch, then record the commanded states and clear the scene
+	const OokScenePlan &send(RFM69OOK &ook, RFM69 &radio);
+private:
+	OokDevice _devices[OOK_SCENE_DEVICES];	// Known devices
+	byte _count;							// Number of known devices
+	unsigned long int _ttl;					// Refresh TTL (ms)
+	OokScenePlan _plan;						// Last compiled plan
+	// Send the queued commands, false if dropped or deferred by the channel access
+	boolean ookSceneFlush(RFM69OOK &ook, RFM69 &radio);
+	// Find a device, NULL if unknown
+	OokDevice *ookSceneFind(byte protocol, unsigned long int addr, byte unit);
+	// State a device is left in by the scene (requested, else last commanded)
+	boolean ookSceneState(const OokDevice &device, boolean &on, byte &dimLevel);
+	// The requested state of a device must be sent
+	boolean ookSceneNeeded(const OokDevice &device, unsigned long int now);
+	// Append a command to the plan
+	void ookScenePlan(RFM69OOK &ook, const OokDevice &device, boolean group, boolean on, byte dimLevel);
+};
+
+#if OOK_SERVICE
+class OokCompletion;
+// Function called by the service worker when a command is terminated
+typedef void (*OokCompletionCallback)(OokCompletion &completion, void *context);
+// Function run by the service worker with the exclusive use of the radio (FSK sending, register access...)
+typedef void (*OokRadioFunction)(RFM69 &radio, void *context);
+/**************************************************** OokCompletion *****************************************************
+* Completion of a command submitted to RFM69OOKService, owned by the submitting task: done() turns true once the 
+* worker has run the command, result() then tells if it was sent. The callback, when given, is called by the worker 
+* just before. A command refused on a full queue is terminated at once as OOK_CHANNEL_DROPPED, in the submitting task.
+* A completion is reused by submitting it again once done.
+/***********************************************************************************************************************/
+class OokCompletion {
+public:
+	// Define a completion with an optional callback
+	OokCompletion(OokCompletionCallback callback = NULL, void *context = NULL);
+	// The command is terminated
+	boolean done();
+	// Result of the terminated command: OOK_CHANNEL_READY or OOK_CHANNEL_FORCED if sent (see channelAccess)
+	byte result();
+	// Wait for the command termination
+	void wait();
+private:
+	friend class RFM69OOKService;
+	std::atomic<boolean> _done;				// Set by the worker once the result is written
+	byte _result;							// Command result
+	OokCompletionCallback _callback;		// Function called by the worker
+	void *_context;							// Callback parameter
+};
+/************************************************** OokServiceCommand ***************************************************
+* Command queued in RFM69OOKService
+/***********************************************************************************************************************/
+struct OokServiceCommand {
+	byte kind;								// OOK_SERVICE_...
+	OokCommand command;						// KAKU command with its timing parameters (OOK_SERVICE_KAKU)
+	const void *data;						// Frame, capture in program memory or function context
+	OokRadioFunction function;				// Function run with the radio (OOK_SERVICE_RADIO)
+	OokCompletion *completion;				// Completion, NULL if none
+};
+/*************************************************** OokServiceQueue ****************************************************
+* Bounded lock-free multiple producers / single consumer queue of OOK_SERVICE_QUEUE commands. Each cell carries a
+* sequence number: producers reserve a cell by a compare and swap of the head and publish it by its sequence, the
+* worker takes the cells in order. push never blocks, it fails on a full queue.
+/***********************************************************************************************************************/
+class OokServiceQueue {
+public:
+	OokServiceQueue();
+	// Queue a command (any task)
+	boolean push(const OokServiceCommand &command);
+	// Take the oldest command (worker only)
+	boolean pop(OokServiceCommand &command);
+private:
+	struct Cell {
+		std::atomic<unsigned int> sequence;	// Position the cell is ready for: push when equal to it, pop when one more
+		OokServiceCommand command;
+	};
+	Cell _cells[OOK_SERVICE_QUEUE];
+	std::atomic<unsigned int> _head;		// Next push position
+	unsigned int _tail;						// Next pop position
+};
+/*************************************************** RFM69OOKService ****************************************************
+* Transmit service owning a RFM69OOK and a RFM69 instance: any task submits commands without blocking, one worker task 
+* runs them one at a time, highest priority first, so that the registers saved by a sending are never mixed up. 
+* Every other use of the radio, FSK sending included, must go through submitRadio once the service is running.
+* Example:	worker task: for (;;) if (!service.poll()) vTaskDelay(1);
+*			other tasks: OokCompletion done; service.submit(command, OOK_PRIORITY_HIGH, &done); done.wait();
+/***********************************************************************************************************************/
+class RFM69OOKService {
+public:
+	// Define a RFM69OOKService Class using a RFM69OOK and a RFM69 instance
+	RFM69OOKService(RFM69OOK &ook, RFM69 &radio);
+	// Queue a KAKU command sent with its timing parameters (any task)
+	boolean submit(const OokCommand &command, byte priority = OOK_PRIORITY_NORMAL, OokCompletion *completion = NULL);
+	// Queue an encoded frame, which must stay valid until the command is terminated (any task)
+	boolean submitFrame(const OokFrame &frame, byte priority = OOK_PRIORITY_NORMAL, OokCompletion *completion = NULL);
+	// Queue a raw capture located in program memory (any task)
+	boolean submitCapture(const byte *capture, byte priority = OOK_PRIORITY_NORMAL, OokCompletion *completion = NULL);
+	// Queue a function run with the exclusive use of the radio (any task)
+	boolean submitRadio(OokRadioFunction function, void *context, byte priority = OOK_PRIORITY_NORMAL, 
+		OokCompletion *completion = NULL);
+	// Run the oldest command of the highest priority (worker task only), false if none is queued
+	boolean poll();
+	// Number of commands refused on a full queue
+	unsigned long int rejected();
+private:
+	RFM69OOK &_ook;							// RFM69OOK instance used by the worker
+	RFM69 &_radio;							// RFM69 instance owned by the service
+	OokServiceQueue _queues[OOK_PRIORITIES];	// One queue per priority
+	std::atomic<unsigned long int> _rejected;	// Commands refused on a full queue
+	// Queue a command with its priority
+	boolean ookServiceSubmit(OokServiceCommand &command, byte priority, OokCompletion *completion);
+	// Run a command, returns its result
+	byte ookServiceRun(const OokServiceCommand &command);
+};
+#endif
+
+/************************************************** RFM69OOKReceiver ***************************************************
+* OOK receiver: the RFM69 is set in continuous OOK reception and the demodulated data on DIO2 is timestamped by a pin 
+* change interrupt into a single producer / single consumer ring. receiveDone() decodes the edges in the main loop.
+* Only one receiver can be active at a time, end() must be called before sending with the same RFM69 and pin.
+/***********************************************************************************************************************/
+class RFM69OOKReceiver {
+public:
+	// Define a RFM69OOKReceiver Class with the default DIO2 pin
+	RFM69OOKReceiver();
+	// Define a RFM69OOKReceiver Class on another DIO2 pin (interrupt capable)
+	RFM69OOKReceiver(byte dataPin);
+	// Select the decoded protocols (bit mask of _BV(OOK_KAKU_...))
+	void setRxProtocols(byte mask);
+	// Switch the RFM69 to continuous OOK reception and start recording edges
+	boolean begin(RFM69 &radio);
+	// Stop recording edges and restore the RFM69 registers
+	void end();
+	// Decode the recorded edges, true when a new message is received
+	boolean receiveDone();
+	// Last received message
+	const OokMessage &getMessage();
+	// Receiver counters
+	const OokRxStats &getRxStats();
+private:
+	byte _ookDataPin;						// RFM69 DIO2 data pin
+	byte _protocols;						// Bit mask of the decoded protocols
+	RFM69 *_radio;							// RFM69 instance in reception
+	byte _saved[4];							// Registers saved by begin
+	volatile unsigned int _ring[OOK_RX_RING_SIZE];	// Level durations, bit 15 set for a HIGH level
+	volatile byte _head;					// Next ring entry written by the interrupt
+	volatile byte _tail;					// Next ring entry read by receiveDone
+	volatile unsigned long int _lastEdge;	// Time of the last edge
+	volatile unsigned int _overruns;		// Edges lost on a full ring
+	unsigned int _seenOverruns;				// Overruns already handled by the decoders
+	boolean _pendingHigh;					// A HIGH level is waiting for the next LOW level
+	unsigned int _high;						// Duration of the waiting HIGH level
+	unsigned long int _prevLow;				// Duration of the last LOW level
+	OokRxDecoder _decoders[3];				// Decoders of OOK_KAKU_NEW, OOK_KAKU_OLD and OOK_KAKU_COGEX
+	OokMessage _message;					// Last received message
+	unsigned long int _messageTime;			// Time of the last frame of the message (ms)
+	OokRxStats _stats;						// Receiver counters
+	static RFM69OOKReceiver *_owner;		// Receiver attached to the pin change interrupt
+	// Pin change interrupt handler
+	static void ookRxIsr();
+	// Record the duration of the level ended by an edge
+	void ookRxEdge();
+	// Restart all decoders
+	void ookRxReset();
+	// Feed a level to the decoders, true when a new message is received
+	boolean ookRxLevel(boolean high, unsigned long int dur);
+	// Feed a HIGH/LOW pulse to the decoders, true when a new message is received
+	boolean ookRxPulse(unsigned int high, unsigned long int low);
+	// Feed a HIGH/LOW pulse to a decoder, true when its frame is complete
+	boolean ookRxDecode(OokRxDecoder &d, unsigned int high, unsigned long int low, boolean retry);
+	// Convert a complete frame into a message, true for a new message
+	boolean ookRxMessage(byte protocol, const OokRxDecoder &d);
 };
 #endif
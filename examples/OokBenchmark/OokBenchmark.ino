@@ -0,0 +1,56 @@
+#include <RFM69OOK.h>
+#include <RFM69.h>
+#include <SPI.h>
+boolean RFM69OOK_DEBUG = false;     // No RFM69OOK Debug function
+RFM69OOK switchKaku;                // RFM69OOK instance using digitalWrite on the OOK data pin
+RFM69OOKFast<RF69_OOK_PIN> fastKaku; // RFM69OOK instance with the OOK data pin resolved at compile time
+ #define NODEID      1              // Dummy node address
+ #define NETWORKID   100            // Dummy network address
+ #define FREQUENCY   RF69_433MHZ    // Match this with the version of your Moteino! (for KAKU only 433MHz is supported
+ RFM69 radio;
+OokFrame frame;
+const unsigned int periods[] = { 250, 300, 375 };
+// Encode cost, air time and edge errors of a frame; dryRun() only drives the data pin, nothing is transmitted
+void benchmark(const char *name, const OokProtocol &protocol, unsigned long int data) {
+  for (byte i = 0; i < sizeof(periods) / sizeof(periods[0]); i++) {
+    fastKaku.setOokParams(periods[i], 4, 10);
+    unsigned long int start = micros();
+    for (byte n = 0; n < 10; n++) fastKaku.encode(frame, protocol, data);
+    unsigned long int encodeUsec = (micros() - start) / 10;
+    OokEdgeErrors slow = switchKaku.dryRun(frame);
+    OokEdgeErrors fast = fastKaku.dryRun(frame);
+    Serial.print(name), Serial.print(" period "), Serial.print(periods[i]);
+    Serial.print(": encode "), Serial.print(encodeUsec), Serial.print(" us");
+    Serial.print(", edges "), Serial.print(fast.edges);
+    Serial.print(", airtime "), Serial.print(fastKaku.airtime(frame)), Serial.print(" us");
+    Serial.print(", max late "), Serial.print(slow.maxLateUsec), Serial.print("/"), Serial.print(fast.maxLateUsec);
+    Serial.print(" us, mean "), Serial.print(slow.meanUsec), Serial.print("/"), Serial.print(fast.meanUsec);
+    Serial.println(" us (digitalWrite/direct)");
+  }
+}
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) {
+     ; // wait for serial port to connect. Needed for Leonardo only
+  }
+  radio.initialize(FREQUENCY,NODEID,NETWORKID);       // Default RFM FSK initialisation
+  // SPI register accesses of a batch of 3 commands, without and with the register shadow cache
+  for (byte cache = 0; cache < 2; cache++) {
+    fastKaku.setRegCache(cache);
+    fastKaku.enqueueKakuNew(1332798, 16, true, false, 0);
+    fastKaku.enqueueKakuOld('D', 16, false);
+    fastKaku.enqueueKakuCogex(12, 1, true);
+    fastKaku.flush(radio);
+    const OokBatchStats &stats = fastKaku.getBatchStats();
+    Serial.print("Register cache "), Serial.print(cache);
+    Serial.print(": "), Serial.print(stats.regReads), Serial.print(" reads, ");
+    Serial.print(stats.regWrites), Serial.println(" writes");
+  }
+}
+void loop() {
+  benchmark("KaKu new", OOK_PROTO_KAKU_NEW, 0x5159F8E1UL);
+  benchmark("KaKu old", OOK_PROTO_KAKU_OLD, 0x0D5UL);
+  benchmark("PT2262  ", OOK_PROTO_PT2262, 0xA5AUL);
+  benchmark("EV1527  ", OOK_PROTO_EV1527, 0xABCDE1UL);
+  delay(10000);
+}
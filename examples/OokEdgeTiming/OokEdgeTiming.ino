@@ -0,0 +1,27 @@
+#include <RFM69OOK.h>
+#include <RFM69.h>
+#include <SPI.h>
+boolean RFM69OOK_DEBUG = false;     // No RFM69OOK Debug function
+RFM69OOK switchKaku;                // RFM69OOK instance using digitalWrite on the OOK data pin
+RFM69OOKFast<RF69_OOK_PIN> fastKaku; // RFM69OOK instance with the OOK data pin resolved at compile time
+void printEdgeStats(const char *name, OokEdgeStats stats) {
+  Serial.print(name);
+  Serial.print(" edge cost: "), Serial.print(stats.edgeCostNs), Serial.print(" ns");
+  Serial.print("; max lateness: "), Serial.print(stats.maxLateUsec), Serial.print(" us");
+  Serial.print("; jitter: "), Serial.print(stats.jitterUsec), Serial.println(" us");
+}
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) {
+     ; // wait for serial port to connect. Needed for Leonardo only
+  }
+  Serial.print("Direct port output: "), Serial.println(OokFastPin<RF69_OOK_PIN>::direct);
+}
+void loop() {
+  printEdgeStats("RFM69OOK    ", switchKaku.measureEdges());   // Only LOW levels are written, nothing is transmitted
+  printEdgeStats("RFM69OOKFast", fastKaku.measureEdges());
+  const OokCalibration &cal = fastKaku.calibrate();           // Worst-case edge error for the current period
+  Serial.print("RFM69OOKFast edge error: "), Serial.print(cal.edgeErrorUsec), Serial.print(" us ("),
+  Serial.print(cal.edgeErrorPermil), Serial.println(" per thousand of the period)");
+  delay(5000);
+}
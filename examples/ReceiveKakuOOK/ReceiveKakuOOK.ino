@@ -0,0 +1,31 @@
+#include <RFM69OOK.h>
+#include <RFM69.h>
+#include <SPI.h>
+boolean RFM69OOK_DEBUG = false;     // No RFM69OOK Debug function
+RFM69OOKReceiver receiver;          // Create a RFM69OOKReceiver instance on the default DIO2 pin
+ #define NODEID      1              // Dummy node address
+ #define NETWORKID   100            // Dummy network address
+ #define FREQUENCY   RF69_433MHZ    // Match this with the version of your Moteino! (for KAKU only 433MHz is supported
+ RFM69 radio;
+void setup() {
+  Serial.begin(115200);
+  //Initialize serial and wait for port to open: 
+  while (!Serial) {
+     ; // wait for serial port to connect. Needed for Leonardo only
+  }
+  radio.initialize(FREQUENCY,NODEID,NETWORKID);       // Default RFM FSK initialisation
+  receiver.setRxProtocols(_BV(OOK_KAKU_NEW) | _BV(OOK_KAKU_OLD)); // Report 12 bits frames as Old Kaku
+  receiver.begin(radio);                              // Switch the RFM69 to continuous OOK reception
+}
+void loop() {
+  if (receiver.receiveDone()) {                       // Print the fields to give to the send functions
+    const OokMessage &msg = receiver.getMessage();
+    if (msg.protocol == OOK_KAKU_NEW) Serial.print("New House Code: "), Serial.print(msg.addr);
+    else if (msg.protocol == OOK_KAKU_OLD) Serial.print("Old House Code: "), Serial.print((char) msg.addr);
+    else Serial.print("Cogex House Code: "), Serial.print(msg.addr);
+    Serial.print(" Unit: "), Serial.print(msg.unit), Serial.print(" On: "), Serial.print(msg.on);
+    if (msg.group) Serial.print(" Group");
+    if (msg.dimLevel) Serial.print(" DIM level: "), Serial.print(msg.dimLevel);
+    Serial.print(" Period: "), Serial.print(msg.periodusec), Serial.println(" us");
+  }
+}
@@ -0,0 +1,77 @@
+#include <RFM69OOK.h>
+#include <RFM69.h>
+#include <SPI.h>
+boolean RFM69OOK_DEBUG = false;     // No RFM69OOK Debug function
+RFM69OOK switchOok;                 // Create a RFMOOK instance with default parameters
+ #define NODEID      1              // Dummy node address
+ #define NETWORKID   100            // Dummy network address
+ #define FREQUENCY   RF69_433MHZ    // Match this with the version of your Moteino! (for KAKU only 433MHz is supported
+ #define OOK_PIN     4              // RFM69 DIO2, any output pin (D3 is used to record)
+ #define RECORD_PIN  3              // Data output of a 433MHz receiver module, must be an interrupt pin (INT1)
+ #define MAX_EDGES   200            // Longest recorded frame
+ #define FRAME_GAP   5000           // LOW level between repeated frames (us), longer than any LOW level of a frame
+ RFM69 radio;
+// Raw capture of House Code 1332798 unit 1 ON (New Kaku, 260us, 5 repeats, 10ms), printed by this sketch
+const byte kakuOn[] PROGMEM = {
+  0x05, 0x0A, 0x03, 0x84, 0x00, 0x04, 0x01, 0x28, 0x0A, 0x14, 0x05, 0x10, 0x20, 0x20, 0x20, 0x20,
+  0x22, 0x00, 0x22, 0x00, 0x20, 0x20, 0x22, 0x00, 0x22, 0x00, 0x22, 0x02, 0x00, 0x20, 0x20, 0x22,
+  0x02, 0x02, 0x02, 0x02, 0x00, 0x20, 0x22, 0x00, 0x20, 0x20, 0x20, 0x21 };
+volatile unsigned long edges[MAX_EDGES];
+volatile unsigned int edgeCount = 0;
+volatile unsigned long lastEdge;
+volatile boolean frameDone;
+boolean recording = true;
+void recordEdge() {                 // Record one frame: from a rising edge after a gap up to the next gap
+  unsigned long now = micros();
+  boolean gap = now - lastEdge > FRAME_GAP;
+  lastEdge = now;
+  if (frameDone) return;
+  if (edgeCount == 0) {
+    if (gap && digitalRead(RECORD_PIN)) edges[edgeCount++] = now;
+  }
+  else if (gap) frameDone = true;   // First repeat gap: the frame ends with its last falling edge
+  else if (edgeCount < MAX_EDGES) edges[edgeCount++] = now;
+  else edgeCount = 0;               // Too long, wait for the next frame
+}
+void setup() {
+  Serial.begin(115200);
+  //Initialize serial and wait for port to open: 
+  while (!Serial) {
+     ; // wait for serial port to connect. Needed for Leonardo only
+  }
+  radio.initialize(FREQUENCY,NODEID,NETWORKID);       // Default RFM FSK initialisation
+  switchOok.setOokPin(OOK_PIN);
+  pinMode(RECORD_PIN, INPUT);
+  if (digitalPinToInterrupt(RECORD_PIN) == NOT_AN_INTERRUPT) {
+    Serial.println("RECORD_PIN is not an interrupt pin, recording disabled");
+    recording = false;
+  }
+}
+void loop() {
+  switchOok.sendCapture(radio, kakuOn);               // Replay the stored capture straight from flash
+  // Record one frame of a remote control (its first repeat, the repeats are added by sendCapture), waiting up to 
+  // one second, then print it as a raw capture to paste in a sketch
+  if (!recording) {
+    delay(5000);
+    return;
+  }
+  edgeCount = 0;
+  frameDone = false;
+  lastEdge = micros();
+  attachInterrupt(digitalPinToInterrupt(RECORD_PIN), recordEdge, CHANGE);
+  for (unsigned long start = millis(); !frameDone && millis() - start < 1000; );
+  detachInterrupt(digitalPinToInterrupt(RECORD_PIN));
+  if (!frameDone) edgeCount = 0;                      // No complete frame
+  byte capture[80];
+  switchOok.setOokParams(300, 5, 10);                 // Repeats and delay stored with the capture
+  unsigned int size = switchOok.encodeCapture(capture, sizeof(capture), (const unsigned long *) edges, edgeCount);
+  if (size) {
+    Serial.print("const byte capture[] PROGMEM = {");
+    for (unsigned int i = 0; i < size; i++) {
+      if (i) Serial.print(", ");
+      Serial.print(capture[i] < 0x10 ? "0x0" : "0x"), Serial.print(capture[i], HEX);
+    }
+    Serial.println(" };");
+  }
+  delay(5000);
+}
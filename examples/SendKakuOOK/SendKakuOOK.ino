@@ -2,7 +2,7 @@
 #include <RFM69OOK.h>
 #include <RFM69.h>
 #include <SPI.h>
-boolean RFM69OOK_DEBUG = true;      // Activate RFM69OOK Debug function
+boolean RFM69OOK_DEBUG = true;      // Activate RFM69OOK Debug function (trace events printed by dumpTrace)
 RFM69OOK switchKaku;                // Create a RFMOOK instance with default parameters
  #define NODEID      1              // Dummy node address
  #define NETWORKID   100            // Dummy network address
@@ -20,13 +20,17 @@ void setup() {
 void loop() {
   switchKaku.setOokParams(250,5,10);        // Configure the specific parameters for new kaku (symbol period 250us, repeat 5 times with delay of 10ms)
   switchKaku.sendKakuNew(radio, 1332798,  16,  true, 0, 0); //  Send command ON via RFM69 radio instance from House Code 1332798 to unit 16 no group, no dim
+  switchKaku.dumpTrace(Serial);             // Print the debug trace once the frames are sent
   delay (5000);
   switchKaku.setOokParams(300, 8,15);        // Configure the specific parameters for old kaku (symbol period 250us, repeat 8 times with delay of 15ms)
   switchKaku.sendKakuOld(radio, 'D', 16, false); // Send command OFF via RFM69 radio instance from House Code 'D' to unit 16
+  switchKaku.dumpTrace(Serial);
   delay (5000);
   switchKaku.setOokParams(350,10,20);     // Configure the specific parameters for cogex kaku (symbol period 350us, repeat 10 times with delay of 20ms)
   switchKaku.sendKakuCogex(radio, 12, 1, true); // Send command ON via RFM69 radio instance from House Code 12 to unit 1
+  switchKaku.dumpTrace(Serial);
   delay (5000);
   switchKaku.sendKakuCogex(radio, 12, 1, false); // Send command OFF via RFM69 radio instance from House Code 12 to unit 1
+  switchKaku.dumpTrace(Serial);
   delay(5000);
 }
@@ -0,0 +1,34 @@
+/**********************************************************************************************************************
+* OokTest.h - Minimal test registry of the RFM69OOK host tests
+*
+* OOK_TEST(name) { ... } defines a test case run by test_main.cpp, OOK_CHECK and OOK_CHECK_NEAR report failures with
+* their location and let the test case go on.
+/**********************************************************************************************************************/
+#ifndef OOKTEST_H
+#define OOKTEST_H
+
+#include <stdio.h>
+
+struct OokTestCase {
+	const char *name;
+	void (*function)();
+	OokTestCase *next;
+	OokTestCase(const char *name, void (*function)());
+};
+// Registered test cases
+extern OokTestCase *ookTestCases;
+// Number of failed checks
+extern unsigned long ookTestFailures;
+// Report a check, returns the condition
+bool ookTestCheck(bool condition, const char *text, const char *file, int line);
+
+#define OOK_TEST(name) \
+	static void name(); \
+	static OokTestCase name##Case(#name, name); \
+	static void name()
+#define OOK_CHECK(condition) ookTestCheck((condition), #condition, __FILE__, __LINE__)
+#define OOK_CHECK_NEAR(value, expected, tolerance) \
+	ookTestCheck((long) (value) - (long) (expected) <= (long) (tolerance) && \
+		(long) (expected) - (long) (value) <= (long) (tolerance), #value " ~ " #expected, __FILE__, __LINE__)
+
+#endif
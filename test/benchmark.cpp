@@ -0,0 +1,84 @@
+/**********************************************************************************************************************
+* benchmark.cpp - Host benchmark of the RFM69OOK encoders and DIO2 sending for each protocol and setOokParams setting
+*
+* For each protocol, pulse time and number of repeats: host encode cost, total airtime, RFM69 SPI transactions of one
+* sending and edge errors of the recorded DIO2 waveform against the encoded durations. With --vcd <file>, the trace of
+* a KAKU New sending is written as a VCD waveform.
+/**********************************************************************************************************************/
+#include <RFM69OOK.h>
+#include <chrono>
+#include <string.h>
+
+#define ENCODES               2000
+
+boolean RFM69OOK_DEBUG = false;
+
+enum { KAKU_NEW, KAKU_OLD, KAKU_COGEX, PT2262, EV1527, HOMEEASY, PROTOCOLS };
+static const char *const names[PROTOCOLS] = { "KAKU New", "KAKU Old", "Cogex", "PT2262", "EV1527", "HomeEasy" };
+
+static void encode(RFM69OOK &ook, OokFrame &frame, byte protocol)
+{
+	switch (protocol)
+	{
+		case KAKU_NEW: ook.encodeKakuNew(frame, 1332798, 3, true, false, 0); break;
+		case KAKU_OLD: ook.encodeKakuOld(frame, 'C', 2, true); break;
+		case KAKU_COGEX: ook.encodeKakuCogex(frame, 9, 4, true); break;
+		case PT2262: ook.encode(frame, OOK_PROTO_PT2262, 0x5A5, 0x003, 0); break;
+		case EV1527: ook.encode(frame, OOK_PROTO_EV1527, 0xA5C3F1, 0, 0); break;
+		default: ook.encode(frame, OOK_PROTO_HOMEEASY, 0x1234567, 0, 0); break;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const unsigned int periods[] = { 200, 260, 375, 500 };
+	const byte repeats[] = { 1, 4 };
+	printf("%-9s %6s %4s %10s %10s %6s %6s %6s %8s %8s %8s\n", "protocol", "period", "rep", "encode ns", "airtime us",
+		"reads", "writes", "edges", "err min", "err max", "err mean");
+	for (byte protocol = 0; protocol < PROTOCOLS; protocol++)
+	for (byte p = 0; p < sizeof(periods) / sizeof(periods[0]); p++)
+	for (byte r = 0; r < sizeof(repeats); r++)
+	{
+		RFM69 radio;
+		RFM69OOK ook;
+		OokFrame frame;
+		ook.setOokParams(periods[p], repeats[r], 10);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < ENCODES; i++) encode(ook, frame, protocol);
+		double encodeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+			ENCODES;
+		ookSimReset();
+		ook.sendFrame(radio, frame);
+		// Expected DIO2 durations of each repeat from the first rising edge, a leading 0 HIGH is not output
+		std::vector<long> expected;
+		byte first = frame.dur[0] == 0 ? 2 : 0;
+		for (byte i = first; i < frame.length; i++) expected.push_back(frame.dur[i] + (i % 2 ? 1 : -1) * OOK_PULSE_TRIM);
+		std::vector<unsigned long> durations = ookSimDurations(RF69_OOK_PIN);
+		long errMin = 0, errMax = 0, errSum = 0;
+		unsigned long compared = 0;
+		for (size_t i = 0; i < durations.size(); i++)
+		{
+			size_t j = i % expected.size();
+			if (j == expected.size() - 1) continue;					// Repeat gap, not a frame duration
+			long error = (long) durations[i] - expected[j];
+			if (!compared || error < errMin) errMin = error;
+			if (!compared || error > errMax) errMax = error;
+			errSum += error < 0 ? -error : error;
+			compared++;
+		}
+		printf("%-9s %6u %4u %10.0f %10lu %6lu %6lu %6lu %8ld %8ld %8.2f\n", names[protocol], periods[p], repeats[r],
+			encodeNs, ook.airtime(frame), ookSimCount(OOK_SIM_REG_READ), ookSimCount(OOK_SIM_REG_WRITE),
+			durations.size() + 1, errMin, errMax, compared ? (double) errSum / compared : 0.0);
+	}
+	if (argc > 2 && !strcmp(argv[1], "--vcd"))
+	{
+		RFM69 radio;
+		RFM69OOK ook;
+		ook.setOokParams(260, 2, 10);
+		ookSimReset();
+		ook.sendKakuNew(radio, 1332798, 3, true, false, 0);
+		if (!ookSimWriteVcd(argv[2], RF69_OOK_PIN)) return 1;
+		printf("KAKU New trace written to %s\n", argv[2]);
+	}
+	return 0;
+}
@@ -0,0 +1,78 @@
+/**********************************************************************************************************************
+* Arduino.h - Host stand-in of the Arduino core used by RFM69OOK, driven by the OokSim virtual clock
+/**********************************************************************************************************************/
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "OokSim.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH                  1
+#define LOW                   0
+#define INPUT                 0
+#define OUTPUT                1
+#define CHANGE                1
+#define DEC                   10
+#define HEX                   16
+#define BIN                   2
+#define NOT_AN_INTERRUPT      -1
+
+#define PROGMEM
+#define pgm_read_byte(p)      (*(const uint8_t *)(p))
+#define pgm_read_word(p)      (*(const uint16_t *)(p))
+#define memcpy_P              memcpy
+#define _BV(b)                (1UL << (b))
+#define bitRead(v, b)         (((v) >> (b)) & 0x01)
+#define bitSet(v, b)          ((v) |= (1UL << (b)))
+#define bitClear(v, b)        ((v) &= ~(1UL << (b)))
+#define lowByte(w)            ((uint8_t) ((w) & 0xff))
+#define highByte(w)           ((uint8_t) ((w) >> 8))
+#define digitalPinToInterrupt(p) (p)
+
+unsigned long micros();
+unsigned long millis();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int usec);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+void noInterrupts();
+void interrupts();
+void yield();
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t interrupt);
+
+class __FlashStringHelper;
+#define F(s)                  (reinterpret_cast<const __FlashStringHelper *>(s))
+
+// Print output written to stdout
+class Stream {
+public:
+	// Print to a file, NULL to discard the output
+	Stream(FILE *file = stdout) : _file(file) {}
+	size_t print(const __FlashStringHelper *s);
+	size_t print(const char *s);
+	size_t print(char c);
+	size_t print(unsigned char n, int base = DEC);
+	size_t print(int n, int base = DEC);
+	size_t print(unsigned int n, int base = DEC);
+	size_t print(long n, int base = DEC);
+	size_t print(unsigned long n, int base = DEC);
+	size_t println();
+	template <class T> size_t println(T value) { size_t n = print(value); return n + println(); }
+	template <class T> size_t println(T value, int base) { size_t n = print(value, base); return n + println(); }
+	void begin(unsigned long) {}
+private:
+	FILE *_file;
+};
+extern Stream Serial;
+
+#endif
@@ -0,0 +1,322 @@
+/**********************************************************************************************************************
+* OokSim.cpp - Virtual clock, waveform trace and Arduino core stand-in of the RFM69OOK host simulation
+/**********************************************************************************************************************/
+#include <Arduino.h>
+#include <RFM69.h>
+#include <RFM69registers.h>
+#include <thread>
+
+// Duration of a register access (two bytes over SPI, us)
+#define OOK_SIM_SPI_USEC      2
+
+static unsigned long simNow = 0;			// Virtual time (us)
+static unsigned long simTick = 1;			// Time added by each clock read
+static std::vector<OokSimEvent> simTrace;
+static uint8_t simPins[64];
+static void (*simIsrs[64])(void);			// Pin change interrupt handlers
+static unsigned long simRandom = 1;
+
+Stream Serial;
+
+/*********************************************** Virtual clock and trace ***********************************************/
+void ookSimReset()
+{
+	simNow = 0;
+	simTick = 1;
+	simTrace.clear();
+	memset(simPins, 0, sizeof(simPins));
+	memset(simIsrs, 0, sizeof(simIsrs));
+}
+unsigned long ookSimNow()
+{
+	return simNow;
+}
+void ookSimAdvance(unsigned long usec)
+{
+	simNow += usec;
+}
+void ookSimSetTick(unsigned long usec)
+{
+	simTick = usec;
+}
+void ookSimRecord(uint8_t kind, uint8_t addr, uint8_t value)
+{
+	OokSimEvent event = { simNow, kind, addr, value };
+	simTrace.push_back(event);
+}
+const std::vector<OokSimEvent> &ookSimTrace()
+{
+	return simTrace;
+}
+uint8_t ookSimPinLevel(uint8_t pin)
+{
+	return simPins[pin & 63];
+}
+std::vector<unsigned long> ookSimDurations(uint8_t pin)
+{
+	std::vector<unsigned long> durations;
+	unsigned long last = 0;
+	bool started = false;
+	for (size_t i = 0; i < simTrace.size(); i++)
+	{
+		const OokSimEvent &event = simTrace[i];
+		if (event.kind != OOK_SIM_PIN || event.addr != pin) continue;
+		if (!started && event.value != HIGH) continue;
+		if (started) durations.push_back(event.time - last);
+		started = true;
+		last = event.time;
+	}
+	return durations;
+}
+void ookSimInput(uint8_t pin, uint8_t level)
+{
+	level = level ? HIGH : LOW;
+	if (simPins[pin & 63] == level) return;
+	simPins[pin & 63] = level;
+	ookSimRecord(OOK_SIM_PIN, pin, level);
+	if (simIsrs[pin & 63]) simIsrs[pin & 63]();
+}
+unsigned long ookSimCount(uint8_t kind)
+{
+	unsigned long count = 0;
+	for (size_t i = 0; i < simTrace.size(); i++) if (simTrace[i].kind == kind) count++;
+	return count;
+}
+bool ookSimWriteVcd(const char *path, uint8_t pin)
+{
+	FILE *file = fopen(path, "w");
+	if (!file) return false;
+	fprintf(file, "$timescale 1us $end\n$scope module rfm69 $end\n");
+	fprintf(file, "$var wire 1 d dio2 $end\n$var wire 16 r regwrite $end\n$upscope $end\n$enddefinitions $end\n");
+	fprintf(file, "#0\n0d\nb0 r\n");
+	for (size_t i = 0; i < simTrace.size(); i++)
+	{
+		const OokSimEvent &event = simTrace[i];
+		if (event.kind == OOK_SIM_PIN && event.addr == pin) fprintf(file, "#%lu\n%dd\n", event.time, event.value);
+		else if (event.kind == OOK_SIM_REG_WRITE)
+		{
+			fprintf(file, "#%lu\nb", event.time);
+			for (int bit = 15; bit >= 0; bit--) fputc((((event.addr << 8) | event.value) >> bit) & 1 ? '1' : '0', file);
+			fprintf(file, " r\n");
+		}
+	}
+	fclose(file);
+	return true;
+}
+
+/************************************************** Arduino core *******************************************************/
+unsigned long micros()
+{
+	unsigned long now = simNow;
+	simNow += simTick;
+	return now;
+}
+unsigned long millis()
+{
+	return micros() / 1000;
+}
+void delay(unsigned long ms)
+{
+	simNow += ms * 1000;
+}
+void delayMicroseconds(unsigned int usec)
+{
+	simNow += usec;
+}
+void pinMode(uint8_t, uint8_t)
+{
+}
+void digitalWrite(uint8_t pin, uint8_t level)
+{
+	level = level ? HIGH : LOW;
+	if (simPins[pin & 63] == level) return;
+	simPins[pin & 63] = level;
+	ookSimRecord(OOK_SIM_PIN, pin, level);
+}
+int digitalRead(uint8_t pin)
+{
+	return simPins[pin & 63];
+}
+long random(long howbig)
+{
+	simRandom = simRandom * 1103515245UL + 12345UL;
+	return howbig > 0 ? (long) ((simRandom >> 16) % (unsigned long) howbig) : 0;
+}
+long random(long howsmall, long howbig)
+{
+	return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall);
+}
+void randomSeed(unsigned long seed)
+{
+	simRandom = seed;
+}
+void noInterrupts()
+{
+}
+void interrupts()
+{
+}
+void yield()
+{
+	std::this_thread::yield();
+}
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int)
+{
+	simIsrs[interrupt & 63] = isr;							// digitalPinToInterrupt(p) is p
+}
+void detachInterrupt(uint8_t interrupt)
+{
+	simIsrs[interrupt & 63] = NULL;
+}
+
+/***************************************************** Stream **********************************************************/
+size_t Stream::print(const __FlashStringHelper *s)
+{
+	return print(reinterpret_cast<const char *>(s));
+}
+size_t Stream::print(const char *s)
+{
+	if (!_file) return strlen(s);
+	return fputs(s, _file) >= 0 ? strlen(s) : 0;
+}
+size_t Stream::print(char c)
+{
+	if (!_file) return 1;
+	return fputc(c, _file) != EOF;
+}
+size_t Stream::print(unsigned char n, int base)
+{
+	return print((unsigned long) n, base);
+}
+size_t Stream::print(int n, int base)
+{
+	return print((long) n, base);
+}
+size_t Stream::print(unsigned int n, int base)
+{
+	return print((unsigned long) n, base);
+}
+size_t Stream::print(long n, int base)
+{
+	if (n < 0 && base == DEC) return print('-') + print((unsigned long) -n, base);
+	return print((unsigned long) n, base);
+}
+size_t Stream::print(unsigned long n, int base)
+{
+	char buffer[8 * sizeof(long) + 1];
+	char *p = buffer + sizeof(buffer) - 1;
+	*p = 0;
+	if (base < 2) base = DEC;
+	do
+	{
+		unsigned long digit = n % base;
+		*--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+		n /= base;
+	} while (n);
+	return print(p);
+}
+size_t Stream::println()
+{
+	return print('\n');
+}
+
+/****************************************************** RFM69 **********************************************************/
+uint8_t RFM69::DATA[RF69_MAX_DATA_LEN + 1];
+uint8_t RFM69::DATALEN;
+uint16_t RFM69::SENDERID;
+uint16_t RFM69::TARGETID;
+uint8_t RFM69::PAYLOADLEN;
+uint8_t RFM69::ACK_REQUESTED;
+int16_t RFM69::RSSI;
+
+RFM69::RFM69()
+{
+	memset(regs, 0, sizeof(regs));
+	regs[REG_OPMODE] = RF_OPMODE_STANDBY;
+	regs[REG_BITRATEMSB] = 0x1A;			// 4.8 kbps FSK defaults
+	regs[REG_BITRATELSB] = 0x0B;
+	regs[REG_FIFOTHRESH] = 0x0F;
+	regs[REG_PACKETCONFIG2] = 0x02;
+	rssi = -100;
+	receiveHook = NULL;
+	fifoDropped = 0;
+	fifoUnderruns = 0;
+	_fifo = 0;
+	_fifoTime = 0;
+	_fifoDry = false;
+}
+bool RFM69::initialize(uint8_t, uint16_t, uint8_t)
+{
+	return true;
+}
+void RFM69::fifoUpdate()
+{
+	unsigned long now = ookSimNow();
+	unsigned long byteUsec = ((regs[REG_BITRATEMSB] << 8) | regs[REG_BITRATELSB]) / 4;	// 8 bits at 32 MHz / rate
+	bool sending = (regs[REG_OPMODE] & 0x1C) == RF_OPMODE_TRANSMITTER && !(regs[REG_DATAMODUL] & 0x60);
+	if (sending && byteUsec)
+	{
+		unsigned long sent = (now - _fifoTime) / byteUsec;
+		if (_fifo && sent >= _fifo) _fifoDry = true;	// The last byte was sent: a later byte leaves a gap
+		if (sent >= _fifo) _fifo = 0;
+		else
+		{
+			_fifo -= sent;
+			now = _fifoTime + sent * byteUsec;	// Keep the part of the byte being sent
+		}
+	}
+	_fifoTime = now;
+}
+uint8_t RFM69::readReg(uint8_t addr)
+{
+	uint8_t value = regs[addr & 0x7F];
+	if (addr == REG_IRQFLAGS1) value |= RF_IRQFLAGS1_MODEREADY;
+	else if (addr == REG_IRQFLAGS2)
+	{
+		fifoUpdate();
+		value = (_fifo >= 66 ? RF_IRQFLAGS2_FIFOFULL : 0) | (_fifo ? RF_IRQFLAGS2_FIFONOTEMPTY : 0) |
+			(_fifo > (regs[REG_FIFOTHRESH] & 0x7Fu) ? RF_IRQFLAGS2_FIFOLEVEL : 0);
+	}
+	ookSimRecord(OOK_SIM_REG_READ, addr, value);
+	ookSimAdvance(OOK_SIM_SPI_USEC);
+	return value;
+}
+void RFM69::writeReg(uint8_t addr, uint8_t value)
+{
+	ookSimRecord(OOK_SIM_REG_WRITE, addr, value);
+	ookSimAdvance(OOK_SIM_SPI_USEC);
+	fifoUpdate();
+	if (addr == REG_FIFO)
+	{
+		if (_fifoDry) fifoUnderruns++;
+		_fifoDry = false;
+		if (_fifo < 66) _fifo++;
+		else fifoDropped++;
+		return;
+	}
+	if (addr == REG_IRQFLAGS2)
+	{
+		if (value & RF_IRQFLAGS2_FIFOOVERRUN) _fifo = 0;
+		_fifoDry = false;
+		return;
+	}
+	if (addr == REG_PACKETCONFIG2) value &= ~RF_PACKET2_RXRESTART;	// Command bit, reads back as 0
+	regs[addr & 0x7F] = value;
+}
+bool RFM69::canSend()
+{
+	return readRSSI() < CSMA_LIMIT;
+}
+bool RFM69::receiveDone()
+{
+	return receiveHook ? receiveHook(*this) : false;
+}
+bool RFM69::ACKRequested()
+{
+	return ACK_REQUESTED != 0;
+}
+int16_t RFM69::readRSSI(bool)
+{
+	ookSimAdvance(20);						// RSSI register read over SPI
+	return rssi;
+}
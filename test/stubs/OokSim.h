@@ -0,0 +1,50 @@
+/**********************************************************************************************************************
+* OokSim.h - Host simulation of the Arduino and RFM69 environment used by the RFM69OOK host tests and benchmark
+*
+* The virtual clock advances by a tick on each micros()/millis() call (the cost of a busy-wait loop turn), by the
+* requested time on delay()/delayMicroseconds() and by ookSimAdvance(). Every pin transition and RFM69 register access
+* is recorded with its time into the waveform trace, which can be written as a VCD file.
+/**********************************************************************************************************************/
+#ifndef OOKSIM_H
+#define OOKSIM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+// Trace event kinds
+#define OOK_SIM_PIN           0				// addr: pin, value: level
+#define OOK_SIM_REG_READ      1				// addr: register, value: read value
+#define OOK_SIM_REG_WRITE     2				// addr: register, value: written value
+
+struct OokSimEvent {
+	unsigned long time;						// Virtual time (us)
+	uint8_t kind;							// OOK_SIM_...
+	uint8_t addr;							// Pin or register address
+	uint8_t value;							// Pin level or register value
+};
+
+// Clear the clock, the trace, the pin levels and interrupt handlers, and set the clock tick back to 1 us
+void ookSimReset();
+// Virtual time (us)
+unsigned long ookSimNow();
+// Advance the virtual clock
+void ookSimAdvance(unsigned long usec);
+// Time added by each micros()/millis() call (us)
+void ookSimSetTick(unsigned long usec);
+// Record an event at the current virtual time
+void ookSimRecord(uint8_t kind, uint8_t addr, uint8_t value);
+// Recorded events
+const std::vector<OokSimEvent> &ookSimTrace();
+// Current level of a pin
+uint8_t ookSimPinLevel(uint8_t pin);
+// Durations between the successive transitions of a pin, starting with the first rising edge (us)
+std::vector<unsigned long> ookSimDurations(uint8_t pin);
+// Drive an input pin (RFM69 DIO2 in reception): a level change is recorded and calls the attached interrupt handler
+void ookSimInput(uint8_t pin, uint8_t level);
+// Number of recorded events of a kind
+unsigned long ookSimCount(uint8_t kind);
+// Write the trace as a VCD waveform: the pin levels and the last register written (addr << 8 | value)
+bool ookSimWriteVcd(const char *path, uint8_t pin);
+
+#endif
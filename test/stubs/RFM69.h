@@ -0,0 +1,50 @@
+/**********************************************************************************************************************
+* RFM69.h - Host stand-in of the LowPowerLab RFM69 class: a register file with a draining FIFO, every access recorded
+* in the OokSim trace and taking 2 us of virtual time
+/**********************************************************************************************************************/
+#ifndef RFM69_H
+#define RFM69_H
+
+#include <Arduino.h>
+
+#define RF69_MAX_DATA_LEN     61
+#define RF69_CSMA_LIMIT_MS    1000
+#define CSMA_LIMIT            -90
+#define RF69_433MHZ           43
+#define RF69_868MHZ           86
+#define RF69_915MHZ           91
+
+class RFM69 {
+public:
+	RFM69();
+	bool initialize(uint8_t freqBand, uint16_t nodeID, uint8_t networkID = 1);
+	uint8_t readReg(uint8_t addr);
+	void writeReg(uint8_t addr, uint8_t value);
+	bool canSend();
+	bool receiveDone();
+	bool ACKRequested();
+	int16_t readRSSI(bool forceTrigger = false);
+
+	static uint8_t DATA[RF69_MAX_DATA_LEN + 1];
+	static uint8_t DATALEN;
+	static uint16_t SENDERID;
+	static uint16_t TARGETID;
+	static uint8_t PAYLOADLEN;
+	static uint8_t ACK_REQUESTED;
+	static int16_t RSSI;
+
+	// Simulation controls
+	uint8_t regs[0x80];						// Register file
+	int16_t rssi;							// RSSI returned by readRSSI (dBm)
+	bool (*receiveHook)(RFM69 &radio);		// Called by receiveDone, NULL for no packet
+	unsigned int fifoDropped;				// Bytes written to a full FIFO
+	unsigned int fifoUnderruns;				// Bytes written to a FIFO that ran empty while transmitting
+private:
+	unsigned int _fifo;						// Bytes in the FIFO
+	unsigned long _fifoTime;				// Time the FIFO level was last updated
+	bool _fifoDry;							// The FIFO ran empty while transmitting
+	// Drain the FIFO at the bit rate while transmitting in packet mode
+	void fifoUpdate();
+};
+
+#endif
@@ -0,0 +1,65 @@
+/**********************************************************************************************************************
+* RFM69registers.h - Subset of the LowPowerLab RFM69 register definitions used by RFM69OOK (same values)
+/**********************************************************************************************************************/
+#ifndef RFM69REGISTERS_H
+#define RFM69REGISTERS_H
+
+#define REG_FIFO                          0x00
+#define REG_OPMODE                        0x01
+#define REG_DATAMODUL                     0x02
+#define REG_BITRATEMSB                    0x03
+#define REG_BITRATELSB                    0x04
+#define REG_RXBW                          0x19
+#define REG_OOKPEAK                       0x1B
+#define REG_IRQFLAGS1                     0x27
+#define REG_IRQFLAGS2                     0x28
+#define REG_PREAMBLEMSB                   0x2C
+#define REG_PREAMBLELSB                   0x2D
+#define REG_SYNCCONFIG                    0x2E
+#define REG_PACKETCONFIG1                 0x37
+#define REG_PAYLOADLENGTH                 0x38
+#define REG_FIFOTHRESH                    0x3C
+#define REG_PACKETCONFIG2                 0x3D
+
+#define RF_OPMODE_SLEEP                   0x00
+#define RF_OPMODE_STANDBY                 0x04
+#define RF_OPMODE_SYNTHESIZER             0x08
+#define RF_OPMODE_TRANSMITTER             0x0C
+#define RF_OPMODE_RECEIVER                0x10
+
+#define RF_DATAMODUL_DATAMODE_PACKET      0x00
+#define RF_DATAMODUL_DATAMODE_CONTINUOUS  0x40
+#define RF_DATAMODUL_DATAMODE_CONTINUOUSNOBSYNC 0x60
+#define RF_DATAMODUL_MODULATIONTYPE_FSK   0x00
+#define RF_DATAMODUL_MODULATIONTYPE_OOK   0x08
+
+#define RF_RXBW_DCCFREQ_010               0x40
+#define RF_RXBW_MANT_16                   0x00
+#define RF_RXBW_EXP_1                     0x06
+
+#define RF_OOKPEAK_THRESHTYPE_PEAK        0x40
+#define RF_OOKPEAK_PEAKTHRESHSTEP_000     0x00
+#define RF_OOKPEAK_PEAKTHRESHDEC_000      0x00
+
+#define RF_IRQFLAGS1_MODEREADY            0x80
+#define RF_IRQFLAGS1_SYNCADDRESSMATCH     0x01
+
+#define RF_IRQFLAGS2_FIFOFULL             0x80
+#define RF_IRQFLAGS2_FIFONOTEMPTY         0x40
+#define RF_IRQFLAGS2_FIFOLEVEL            0x20
+#define RF_IRQFLAGS2_FIFOOVERRUN          0x10
+#define RF_IRQFLAGS2_PACKETSENT           0x08
+
+#define RF_SYNC_OFF                       0x00
+
+#define RF_PACKET1_FORMAT_FIXED           0x00
+#define RF_PACKET1_DCFREE_OFF             0x00
+#define RF_PACKET1_CRC_OFF                0x00
+#define RF_PACKET1_ADRSFILTERING_OFF      0x00
+
+#define RF_FIFOTHRESH_TXSTART_FIFONOTEMPTY 0x80
+
+#define RF_PACKET2_RXRESTART              0x04
+#define RF_PACKET2_AES_ON                 0x01
+
+#endif
@@ -0,0 +1,52 @@
+/**********************************************************************************************************************
+* test_async.cpp - Asynchronous sending with the virtual timer: the channel access never blocks beginSend...
+/**********************************************************************************************************************/
+#include <RFM69OOK.h>
+#include "OokTest.h"
+
+// Run an asynchronous sending to its end, advancing the simulation clock and the timer together (returns ms)
+static unsigned long runAsync(RFM69OOK &ook, OokVirtualTimer &timer)
+{
+	unsigned long start = ookSimNow();
+	while (ook.isBusy() || ook.lastChannelAccess() == OOK_CHANNEL_BUSY)
+	{
+		ookSimAdvance(100);
+		timer.advance(100);
+	}
+	return (ookSimNow() - start) / 1000;
+}
+
+// A clear channel starts the sending from beginSend..., with the default RFM69 canSend test
+OOK_TEST(asyncClearChannelStartsAtOnce)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	OokVirtualTimer timer;
+	ook.setOokTimer(timer);
+	ook.setOokParams(260, 2, 5);
+	OOK_CHECK(ook.beginSendKakuNew(radio, 1332798, 1, true, false, 0));
+	OOK_CHECK(ookSimPinLevel(RF69_OOK_PIN) == HIGH);				// First edge output
+	OOK_CHECK(ook.lastChannelAccess() == OOK_CHANNEL_READY);
+	runAsync(ook, timer);
+	OOK_CHECK(ookSimPinLevel(RF69_OOK_PIN) == LOW);
+}
+
+// A busy channel is sampled by isBusy: beginSend... returns at once and the forced sending starts at the time limit
+OOK_TEST(asyncBusyChannelDoesNotBlock)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	OokVirtualTimer timer;
+	ook.setOokTimer(timer);
+	ook.setOokParams(260, 1, 5);
+	radio.rssi = -50;
+	unsigned long start = ookSimNow();
+	OOK_CHECK(ook.beginSendKakuNew(radio, 1332798, 1, true, false, 0));
+	OOK_CHECK(ookSimNow() - start < 1000);
+	OOK_CHECK(ook.isBusy());
+	OOK_CHECK(ookSimPinLevel(RF69_OOK_PIN) == LOW);
+	unsigned long elapsed = runAsync(ook, timer);
+	OOK_CHECK(ook.lastChannelAccess() == OOK_CHANNEL_FORCED);
+	OOK_CHECK(elapsed >= RF69_CSMA_LIMIT_MS && elapsed < RF69_CSMA_LIMIT_MS + 100);
+	OOK_CHECK(!ookSimDurations(RF69_OOK_PIN).empty());
+}
@@ -0,0 +1,34 @@
+/**********************************************************************************************************************
+* test_batch.cpp - Batched sending (enqueue/flush) statistics
+/**********************************************************************************************************************/
+#include <RFM69OOK.h>
+#include "OokTest.h"
+
+// Flush three commands, returns the batch statistics
+static OokBatchStats flushThree(RFM69OOK &ook, RFM69 &radio)
+{
+	ook.setOokParams(260, 2, 5);
+	ook.enqueueKakuNew(1332798, 1, true, false, 0);
+	ook.enqueueKakuOld('B', 2, true);
+	ook.enqueueKakuCogex(3, 4, false);
+	ook.flush(radio);
+	return ook.getBatchStats();
+}
+
+// The saved accesses are two pre/post sending cycles, whatever the frames add (FIFO refills, standby gaps)
+OOK_TEST(flushSavingsDoNotWrap)
+{
+	for (byte mode = 0; mode < 3; mode++)
+	{
+		RFM69 radio;
+		RFM69OOK ook;
+		if (mode == 1) ook.setOokBackend(OOK_BACKEND_FIFO);
+		if (mode == 2) ook.setLowPower(true);
+		OokBatchStats stats = flushThree(ook, radio);
+		OOK_CHECK(stats.commands == 3);
+		OOK_CHECK(stats.frames == 6);
+		OOK_CHECK(stats.regReadsSaved > 0 && stats.regReadsSaved <= 2 * stats.regReads);
+		OOK_CHECK(stats.regWritesSaved > 0 && stats.regWritesSaved <= 2 * stats.regWrites);
+		OOK_CHECK(stats.regReadsSaved % 2 == 0 && stats.regWritesSaved % 2 == 0);
+	}
+}
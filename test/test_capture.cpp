@@ -0,0 +1,122 @@
+/**********************************************************************************************************************
+* test_capture.cpp - Raw captures: edge times encoded by encodeCapture, unpacked here independently of
+* OokCaptureSource, and replayed by sendCapture on the DIO2 pin (captures are read from RAM on the host)
+/**********************************************************************************************************************/
+#include <RFM69OOK.h>
+#include <vector>
+#include "OokTest.h"
+
+// Edge tolerance of the replayed capture (us): clock tick plus the edge lead
+#define EDGE_TOLERANCE        3
+
+typedef std::vector<unsigned long> Edges;
+
+// Edge times of HIGH/LOW durations, each off by up to +/- spread % (deterministic), the first edge at 1 ms
+static Edges edgesOf(const std::vector<unsigned int> &durations, int spread)
+{
+	Edges edges(1, 1000);
+	for (size_t i = 0; i < durations.size(); i++)
+		edges.push_back(edges.back() + durations[i] + (long) durations[i] * ((int) (i * 37 % 11) - 5) * spread / 500);
+	return edges;
+}
+// Durations of a capture, from its header, table and packed indices
+static std::vector<unsigned int> unpack(const byte *capture)
+{
+	byte symbols = capture[OOK_CAPTURE_COUNT];
+	unsigned int length = capture[OOK_CAPTURE_LENGTH] | capture[OOK_CAPTURE_LENGTH + 1] << 8;
+	byte bits = symbols <= 2 ? 1 : symbols <= 4 ? 2 : 4;
+	const byte *index = capture + OOK_CAPTURE_HEADER + 2 * symbols;
+	std::vector<unsigned int> durations;
+	for (unsigned int i = 0; i < length; i++)
+	{
+		unsigned int bit = i * bits;
+		byte s = (index[bit / 8] >> (8 - bits - bit % 8)) & ((1 << bits) - 1);
+		if (!OOK_CHECK(s < symbols)) break;
+		const byte *value = capture + OOK_CAPTURE_HEADER + 2 * s;
+		durations.push_back(value[0] | value[1] << 8);
+	}
+	return durations;
+}
+// Expected capture size: header, table and packed indices of an even number of durations
+static unsigned int captureSize(byte symbols, unsigned int durations)
+{
+	unsigned int length = (durations + 1) & ~1u;
+	return OOK_CAPTURE_HEADER + 2 * symbols + (length * OOK_CAPTURE_BITS(symbols) + 7) / 8;
+}
+
+// A jittered KAKU New frame is quantized within OOK_CAPTURE_TOLERANCE and replayed with the DIO2 edge timing
+OOK_TEST(captureRoundTrip)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	ook.setOokParams(260, 1, 5);
+	OokFrame frame;
+	ook.encodeKakuNew(frame, 1332798, 1, true, false, 0);
+	Edges edges = edgesOf(std::vector<unsigned int>(frame.dur, frame.dur + frame.length), 5);
+	byte capture[64];
+	unsigned int size = ook.encodeCapture(capture, sizeof(capture), &edges[0], edges.size());
+	OOK_CHECK(size == captureSize(3, frame.length) && size == 44);
+	OOK_CHECK(capture[OOK_CAPTURE_REPEATS] == 1 && capture[OOK_CAPTURE_REPDLY] == 5);
+	std::vector<unsigned int> durations = unpack(capture);
+	if (!OOK_CHECK(durations.size() == frame.length)) return;
+	unsigned int outside = 0;
+	for (size_t i = 0; i < durations.size(); i++)
+	{
+		unsigned long recorded = edges[i + 1] - edges[i];
+		unsigned long diff = durations[i] > recorded ? durations[i] - recorded : recorded - durations[i];
+		if (diff * 100 > recorded * OOK_CAPTURE_TOLERANCE) outside++;
+		if (durations[i] + 15 < frame.dur[i] || durations[i] > frame.dur[i] + 15) outside++;	// Jitter averaged out
+	}
+	OOK_CHECK(outside == 0);
+	ook.sendCapture(radio, capture);
+	std::vector<unsigned long> output = ookSimDurations(RF69_OOK_PIN);
+	if (!OOK_CHECK(output.size() == durations.size() - 1)) return;
+	unsigned int bad = 0;
+	for (size_t i = 0; i < output.size(); i++)
+	{
+		unsigned int high = durations[i & ~1];
+		unsigned long expected = (i & 1) ? durations[i] + OOK_HIGH_TRIM(high) : high - OOK_HIGH_TRIM(high);
+		if (output[i] + EDGE_TOLERANCE < expected || output[i] > expected + EDGE_TOLERANCE) bad++;
+	}
+	OOK_CHECK(bad == 0);
+}
+
+// 1, 2 and 4 bits indices are packed MSB first, an odd number of durations is completed by a 0 LOW duration
+OOK_TEST(captureIndexPacking)
+{
+	RFM69OOK ook;
+	static const byte values[] = { 1, 2, 3, 7 };						// Distinct durations
+	for (byte v = 0; v < sizeof(values); v++)
+	{
+		for (unsigned int count = 13; count <= 14; count++)				// Odd then even number of durations
+		{
+			std::vector<unsigned int> durations;
+			for (unsigned int i = 0; i < count; i++) durations.push_back(200 << (i * 5 % values[v]));
+			Edges edges = edgesOf(durations, 0);
+			byte symbols = values[v] + (count & 1);							// The 0 LOW duration takes a value
+			byte capture[32];
+			unsigned int size = ook.encodeCapture(capture, sizeof(capture), &edges[0], edges.size());
+			OOK_CHECK(size == captureSize(symbols, count));
+			OOK_CHECK(capture[OOK_CAPTURE_COUNT] == symbols);
+			if (count & 1) durations.push_back(0);
+			OOK_CHECK(unpack(capture) == durations);
+		}
+	}
+}
+
+// More than OOK_CAPTURE_SYMBOLS different durations, or a buffer too small for the capture, give no capture
+OOK_TEST(captureLimits)
+{
+	RFM69OOK ook;
+	std::vector<unsigned int> durations;
+	for (unsigned int i = 0, dur = 100; i < OOK_CAPTURE_SYMBOLS; i++, dur = dur * 13 / 10) durations.push_back(dur);
+	Edges edges = edgesOf(durations, 0);
+	byte capture[64];
+	unsigned int size = captureSize(OOK_CAPTURE_SYMBOLS, durations.size());
+	OOK_CHECK(ook.encodeCapture(capture, size, &edges[0], edges.size()) == size);
+	OOK_CHECK(ook.encodeCapture(capture, size - 1, &edges[0], edges.size()) == 0);
+	durations.push_back(10000);													// 17 values
+	edges = edgesOf(durations, 0);
+	OOK_CHECK(ook.encodeCapture(capture, sizeof(capture), &edges[0], edges.size()) == 0);
+	OOK_CHECK(ook.encodeCapture(capture, sizeof(capture), &edges[0], 1) == 0);
+}
@@ -0,0 +1,41 @@
+/**********************************************************************************************************************
+* test_coexistence.cpp - FSK reception between OOK repeats (setCoexistence)
+/**********************************************************************************************************************/
+#include <RFM69OOK.h>
+#include "OokTest.h"
+
+#if OOK_FSK_PACKETS
+#if OOK_STATS
+// Send a KAKU New command with a blind window shorter than one repeat, returns the number of FSK gaps
+static unsigned long fskGaps(byte repeats)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	ook.setCoexistence(10, 5);
+	ook.setOokParams(260, repeats, 10);
+	ook.sendKakuNew(radio, 1332798, 1, true, false, 0);
+	return ook.getStats().fskGaps;
+}
+
+// A FSK window is opened between repeats only, never after the last one
+OOK_TEST(fskGapsBetweenRepeatsOnly)
+{
+	OOK_CHECK(fskGaps(1) == 0);
+	OOK_CHECK(fskGaps(3) == 2);
+}
+#endif
+
+// The RFM69 is left receiving FSK after a sending with FSK gaps, in its recorded FSK modulation
+OOK_TEST(fskReceiveModeRestored)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	radio.regs[REG_OPMODE] = RF_OPMODE_STANDBY;
+	radio.regs[REG_DATAMODUL] = RF_DATAMODUL_MODULATIONTYPE_FSK;
+	ook.setCoexistence(10, 5);
+	ook.setOokParams(260, 3, 10);
+	ook.sendKakuNew(radio, 1332798, 1, true, false, 0);
+	OOK_CHECK(radio.regs[REG_OPMODE] == RF_OPMODE_RECEIVER);
+	OOK_CHECK(radio.regs[REG_DATAMODUL] == RF_DATAMODUL_MODULATIONTYPE_FSK);
+}
+#endif
@@ -0,0 +1,37 @@
+/**********************************************************************************************************************
+* test_energy.cpp - Carrier time of the last sending reported by lastEnergy
+/**********************************************************************************************************************/
+#include <RFM69OOK.h>
+#include "OokTest.h"
+
+#if OOK_STATS
+// Nominal carrier time of the HIGH levels recorded on a pin (us), each ended OOK_PULSE_TRIM us early
+static unsigned long carrierOf(uint8_t pin)
+{
+	std::vector<unsigned long> durations = ookSimDurations(pin);
+	unsigned long carrier = 0;
+	for (size_t i = 0; i < durations.size(); i += 2) carrier += durations[i] + OOK_PULSE_TRIM;
+	return carrier;
+}
+
+// Frames sent together by RFM69OOKMulti count their carrier time like single sendings
+OOK_TEST(multiCarrierCounted)
+{
+	RFM69 radioA, radioB;
+	RFM69OOK ookA, ookB;
+	ookB.setOokPin(5);
+	ookA.setOokParams(260, 2, 5);
+	ookB.setOokParams(375, 3, 5);
+	OokFrame frameA, frameB;
+	ookA.encodeKakuNew(frameA, 1332798, 1, true, false, 0);
+	ookB.encodeKakuNew(frameB, 4242, 2, false, false, 0);
+	RFM69OOKMulti multi;
+	OOK_CHECK(multi.add(ookA, radioA, frameA));
+	OOK_CHECK(multi.add(ookB, radioB, frameB));
+	multi.send();
+	// One clock tick of edge jitter per HIGH level
+	OOK_CHECK_NEAR(ookA.lastEnergy().carrierUsec, carrierOf(RF69_OOK_PIN), frameA.length / 2 * frameA.repeats);
+	OOK_CHECK_NEAR(ookB.lastEnergy().carrierUsec, carrierOf(5), frameB.length / 2 * frameB.repeats);
+	OOK_CHECK(ookA.lastEnergy().carrierUsec < ookA.lastEnergy().txOnUsec);
+}
+#endif
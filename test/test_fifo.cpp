@@ -0,0 +1,124 @@
+/**********************************************************************************************************************
+* test_fifo.cpp - FIFO transmit backend: the chip stream written to the RFM69 FIFO, read back from the register trace,
+* against the frame durations; the refill of frames longer than the FIFO and the packet engine registers
+/**********************************************************************************************************************/
+#include <RFM69OOK.h>
+#include <vector>
+#include "OokTest.h"
+
+typedef std::vector<byte> Chips;
+
+// Chips of a frame with its repeats, one per pulse time, packed MSB first, the last byte padded with LOW chips
+static Chips chipsOf(const OokFrame &frame)
+{
+	std::vector<bool> levels;
+	for (byte repeat = 0; repeat < frame.repeats; repeat++)
+	{
+		if (repeat) levels.insert(levels.end(), (frame.repDly * 1000UL + frame.periodusec / 2) / frame.periodusec, false);
+		for (byte i = 0; i < frame.length; i++)
+			levels.insert(levels.end(), (frame.dur[i] + frame.periodusec / 2) / frame.periodusec, !(i & 1));
+	}
+	Chips chips((levels.size() + 7) / 8, 0);
+	for (size_t i = 0; i < levels.size(); i++) if (levels[i]) chips[i / 8] |= 0x80 >> (i % 8);
+	return chips;
+}
+// Bytes written to the FIFO, from the register trace
+static Chips fifoWrites()
+{
+	Chips chips;
+	const std::vector<OokSimEvent> &trace = ookSimTrace();
+	for (size_t i = 0; i < trace.size(); i++)
+		if (trace[i].kind == OOK_SIM_REG_WRITE && trace[i].addr == REG_FIFO) chips.push_back(trace[i].value);
+	return chips;
+}
+// Time of the first FIFO write (0 for none)
+static unsigned long firstFifoWrite()
+{
+	const std::vector<OokSimEvent> &trace = ookSimTrace();
+	for (size_t i = 0; i < trace.size(); i++)
+		if (trace[i].kind == OOK_SIM_REG_WRITE && trace[i].addr == REG_FIFO) return trace[i].time;
+	return 0;
+}
+// Last value written to a register before a time
+static byte lastWrite(byte addr, unsigned long before, byte initial)
+{
+	const std::vector<OokSimEvent> &trace = ookSimTrace();
+	for (size_t i = 0; i < trace.size() && trace[i].time < before; i++)
+		if (trace[i].kind == OOK_SIM_REG_WRITE && trace[i].addr == addr) initial = trace[i].value;
+	return initial;
+}
+
+// A repeated KAKU New frame longer than the FIFO is refilled without loss nor underrun, at the frame bit rate
+OOK_TEST(fifoChipStream)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	ook.setOokBackend(OOK_BACKEND_FIFO);
+	ook.setOokParams(260, 4, 5);
+	OokFrame frame;
+	ook.encodeKakuNew(frame, 1332798, 1, true, false, 0);
+	Chips expected = chipsOf(frame);
+	OOK_CHECK(expected.size() > 2 * OOK_FIFO_SIZE);
+	unsigned long start = ookSimNow();
+	ook.sendFrame(radio, frame);
+	unsigned long elapsed = ookSimNow() - start;
+	OOK_CHECK(fifoWrites() == expected);
+	OOK_CHECK(radio.fifoDropped == 0 && radio.fifoUnderruns == 0);
+	OOK_CHECK(elapsed >= expected.size() * 8 * 260UL && elapsed < expected.size() * 8 * 260UL + 20 * 260UL);
+	unsigned long firstChip = firstFifoWrite();
+	OOK_CHECK((lastWrite(REG_BITRATEMSB, firstChip, 0) << 8 | lastWrite(REG_BITRATELSB, firstChip, 0)) == 260 * 32);
+	OOK_CHECK(ookSimCount(OOK_SIM_PIN) == 0);							// No DIO2 output
+}
+
+// The pulse time is limited to OOK_FIFO_MAX_PERIOD (16 bits bit rate register), a longer one is not sent
+OOK_TEST(fifoMaxPeriod)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	ook.setOokBackend(OOK_BACKEND_FIFO);
+	ook.setOokParams(OOK_FIFO_MAX_PERIOD, 1, 5);
+	OokFrame frame;
+	ook.encodeKakuOld(frame, 'A', 1, true);
+	ook.sendFrame(radio, frame);
+	OOK_CHECK(fifoWrites() == chipsOf(frame));
+	OOK_CHECK(lastWrite(REG_BITRATEMSB, firstFifoWrite(), 0) == (OOK_FIFO_MAX_PERIOD * 32) >> 8);
+	OOK_CHECK(lastWrite(REG_BITRATELSB, firstFifoWrite(), 0) == ((OOK_FIFO_MAX_PERIOD * 32) & 0xFF));
+	ookSimReset();
+	ook.setOokParams(OOK_FIFO_MAX_PERIOD + 1, 1, 5);
+	ook.encodeKakuOld(frame, 'A', 1, true);
+	ook.sendFrame(radio, frame);
+	OOK_CHECK(fifoWrites().empty());
+	OOK_CHECK(ookSimCount(OOK_SIM_PIN) == 0);
+}
+
+// The packet engine registers are set for a raw chip stream during the sending and restored afterwards
+OOK_TEST(fifoRegistersRestored)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	ook.setOokBackend(OOK_BACKEND_FIFO);
+	radio.regs[REG_OPMODE] = RF_OPMODE_RECEIVER;
+	radio.regs[REG_PREAMBLEMSB] = 0x00;
+	radio.regs[REG_PREAMBLELSB] = 0x03;
+	radio.regs[REG_SYNCCONFIG] = 0x88;
+	radio.regs[REG_PACKETCONFIG1] = 0x90;
+	radio.regs[REG_PAYLOADLENGTH] = 0x42;
+	radio.regs[REG_FIFOTHRESH] = 0x8F;
+	radio.regs[REG_PACKETCONFIG2] = 0x12 | RF_PACKET2_AES_ON;
+	byte saved[0x80];
+	memcpy(saved, radio.regs, sizeof(saved));
+	ook.setOokParams(260, 2, 5);
+	OokFrame frame;
+	ook.encodeKakuNew(frame, 1332798, 1, true, false, 0);
+	ook.sendFrame(radio, frame);
+	unsigned long firstChip = firstFifoWrite();
+	OOK_CHECK(firstChip != 0);
+	OOK_CHECK(lastWrite(REG_DATAMODUL, firstChip, saved[REG_DATAMODUL]) ==
+		(RF_DATAMODUL_DATAMODE_PACKET | RF_DATAMODUL_MODULATIONTYPE_OOK));
+	OOK_CHECK(lastWrite(REG_PREAMBLELSB, firstChip, saved[REG_PREAMBLELSB]) == 0);
+	OOK_CHECK(lastWrite(REG_SYNCCONFIG, firstChip, saved[REG_SYNCCONFIG]) == RF_SYNC_OFF);
+	OOK_CHECK(lastWrite(REG_PAYLOADLENGTH, firstChip, saved[REG_PAYLOADLENGTH]) == 0);
+	OOK_CHECK((lastWrite(REG_FIFOTHRESH, firstChip, saved[REG_FIFOTHRESH]) & 0x7F) == OOK_FIFO_THRESHOLD);
+	OOK_CHECK((lastWrite(REG_PACKETCONFIG2, firstChip, saved[REG_PACKETCONFIG2]) & RF_PACKET2_AES_ON) == 0);
+	OOK_CHECK(memcmp(saved, radio.regs, sizeof(saved)) == 0);
+}
@@ -0,0 +1,230 @@
+/**********************************************************************************************************************
+* test_kaku.cpp - Edge timings of the KAKU New, Old and Cogex sendings against the reference protocol timings
+*
+* The references are built here from the protocol definitions, independently of the library descriptors. On the DIO2
+* pin each HIGH level is OOK_PULSE_TRIM us shorter and each LOW level OOK_PULSE_TRIM us longer than nominal.
+/**********************************************************************************************************************/
+#include <RFM69OOK.h>
+#include <vector>
+#include "OokTest.h"
+
+// Edge tolerance against the reference (us): clock tick plus the edge lead
+#define EDGE_TOLERANCE        3
+
+typedef std::vector<unsigned int> Pulses;		// HIGH, LOW pairs in pulse time units
+
+static void pulse(Pulses &pulses, unsigned int high, unsigned int low)
+{
+	pulses.push_back(high);
+	pulses.push_back(low);
+}
+// KAKU New: sync 1T,10T, 32 bits MSB first (0: 1,1,1,5; 1: 1,5,1,1), level bit replaced by 1,1,1,1 and 4 dim bits
+// appended with a dim level, stop 1T,10T. Datagram: address (26 bits), group, level, unit - 1 (4 bits)
+static Pulses referenceKakuNew(unsigned long addr, byte unit, bool on, bool group, byte dimLevel)
+{
+	unsigned long datagram = addr << 6 | (group ? 0x20 : (unit - 1) & 0x0F) | (on ? 0x10 : 0);
+	if (!on) dimLevel = 0;
+	Pulses pulses;
+	pulse(pulses, 1, 10);
+	for (int bit = 31; bit >= 0; bit--)
+	{
+		if (dimLevel && bit == 4) { pulse(pulses, 1, 1); pulse(pulses, 1, 1); }
+		else if ((datagram >> bit) & 1) { pulse(pulses, 1, 5); pulse(pulses, 1, 1); }
+		else { pulse(pulses, 1, 1); pulse(pulses, 1, 5); }
+	}
+	for (int bit = 3; dimLevel && bit >= 0; bit--)
+	{
+		if ((dimLevel >> bit) & 1) { pulse(pulses, 1, 5); pulse(pulses, 1, 1); }
+		else { pulse(pulses, 1, 1); pulse(pulses, 1, 5); }
+	}
+	pulse(pulses, 1, 10);
+	return pulses;
+}
+// KAKU Old and Cogex: lead LOW 3T, start 1T,3T, 12 bits LSB first (0: 1,3,1,3; 1: 3,1,1,3)
+static Pulses referenceKakuOld(unsigned int datagram)
+{
+	Pulses pulses;
+	pulse(pulses, 1, 3);
+	for (int bit = 0; bit < 12; bit++)
+	{
+		if ((datagram >> bit) & 1) { pulse(pulses, 3, 1); pulse(pulses, 1, 3); }
+		else { pulse(pulses, 1, 3); pulse(pulses, 1, 3); }
+	}
+	return pulses;
+}
+// Old datagram: house code A..P (4 bits), unit - 1 (4 bits), fixed 0x600, level bit 11
+static unsigned int datagramKakuOld(char addr, byte unit, bool on)
+{
+	return 0x600 | ((unit - 1) << 4) | (addr - 'A') | (on ? 0x800 : 0);
+}
+// Cogex datagram: address << 1, unit << 5, fixed 0x600, level bits 0 and 11
+static unsigned int datagramKakuCogex(byte addr, byte unit, bool on)
+{
+	return 0x600 | unit << 5 | addr << 1 | (on ? 0x801 : 0);
+}
+// Compare the recorded DIO2 durations of one frame with a reference, the last LOW level has no closing edge
+static void checkFrame(const Pulses &reference, unsigned int periodusec, unsigned long tolerance = EDGE_TOLERANCE)
+{
+	std::vector<unsigned long> durations = ookSimDurations(RF69_OOK_PIN);
+	if (!OOK_CHECK(durations.size() == reference.size() - 1)) return;
+	unsigned long worst = 0;
+	for (size_t i = 0; i < durations.size(); i++)
+	{
+		long expected = reference[i] * periodusec + (i % 2 ? OOK_PULSE_TRIM : -OOK_PULSE_TRIM);
+		long error = (long) durations[i] - expected;
+		if ((unsigned long) labs(error) > worst) worst = labs(error);
+	}
+	OOK_CHECK(worst <= tolerance);
+}
+
+OOK_TEST(kakuNewEdgeTimings)
+{
+	const unsigned int periods[] = { 260, 300, 375 };
+	for (byte i = 0; i < 3; i++)
+	{
+		RFM69 radio;
+		RFM69OOK ook;
+		ook.setOokParams(periods[i], 1, 10);
+		ookSimReset();
+		ook.sendKakuNew(radio, 1332798, 5, true, false, 0);
+		checkFrame(referenceKakuNew(1332798, 5, true, false, 0), periods[i]);
+		ookSimReset();
+		ook.sendKakuNew(radio, 1332798, 16, false, false, 0);
+		checkFrame(referenceKakuNew(1332798, 16, false, false, 0), periods[i]);
+		ookSimReset();
+		ook.sendKakuNew(radio, 67108863UL, 1, true, true, 0);
+		checkFrame(referenceKakuNew(67108863UL, 1, true, true, 0), periods[i]);
+	}
+}
+
+OOK_TEST(kakuNewDimEdgeTimings)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	ook.setOokParams(260, 1, 10);
+	for (byte dim = 1; dim < 16; dim += 7)
+	{
+		ookSimReset();
+		ook.sendKakuNew(radio, 1332798, 3, true, false, dim);
+		checkFrame(referenceKakuNew(1332798, 3, true, false, dim), 260);
+	}
+}
+
+OOK_TEST(kakuOldEdgeTimings)
+{
+	const unsigned int periods[] = { 260, 375 };
+	for (byte i = 0; i < 2; i++)
+	{
+		RFM69 radio;
+		RFM69OOK ook;
+		ook.setOokParams(periods[i], 1, 10);
+		for (char addr = 'A'; addr <= 'P'; addr += 5)
+		{
+			ookSimReset();
+			ook.sendKakuOld(radio, addr, 3, true);
+			checkFrame(referenceKakuOld(datagramKakuOld(addr, 3, true)), periods[i]);
+			ookSimReset();
+			ook.sendKakuOld(radio, addr, 16, false);
+			checkFrame(referenceKakuOld(datagramKakuOld(addr, 16, false)), periods[i]);
+		}
+	}
+}
+
+OOK_TEST(kakuCogexEdgeTimings)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	ook.setOokParams(375, 1, 10);
+	for (byte unit = 1; unit <= 15; unit += 7)
+	{
+		ookSimReset();
+		ook.sendKakuCogex(radio, 9, unit, true);
+		checkFrame(referenceKakuOld(datagramKakuCogex(9, unit, true)), 375);
+		ookSimReset();
+		ook.sendKakuCogex(radio, 2, unit, false);
+		checkFrame(referenceKakuOld(datagramKakuCogex(2, unit, false)), 375);
+	}
+}
+
+// Deadlines are absolute: a slow busy-wait loop delays single edges, it does not stretch the frame
+OOK_TEST(edgeErrorsDoNotAccumulate)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	ook.setOokParams(260, 1, 10);
+	ookSimSetTick(4);
+	ook.sendKakuNew(radio, 1332798, 1, true, false, 0);
+	checkFrame(referenceKakuNew(1332798, 1, true, false, 0), 260, 8);
+	const std::vector<OokSimEvent> &trace = ookSimTrace();
+	unsigned long first = 0, last = 0;
+	for (size_t i = 0; i < trace.size(); i++)
+	{
+		if (trace[i].kind != OOK_SIM_PIN) continue;
+		if (!first) first = trace[i].time;
+		last = trace[i].time;
+	}
+	Pulses reference = referenceKakuNew(1332798, 1, true, false, 0);
+	unsigned long span = 0;
+	for (size_t i = 0; i + 1 < reference.size(); i++) span += reference[i] * 260;
+	OOK_CHECK_NEAR(last - first, span - OOK_PULSE_TRIM, 8);
+}
+
+// Repeats are separated by the last LOW level, the repeat delay and the next lead LOW level
+OOK_TEST(repeatsAndDelay)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	ook.setOokParams(260, 4, 10);
+	ook.sendKakuOld(radio, 'C', 2, true);
+	std::vector<unsigned long> durations = ookSimDurations(RF69_OOK_PIN);
+	Pulses frame = referenceKakuOld(datagramKakuOld('C', 2, true));
+	if (!OOK_CHECK(durations.size() == 4 * frame.size() - 1)) return;
+	for (byte repeat = 0; repeat < 3; repeat++)
+	{
+		unsigned long gap = durations[(repeat + 1) * frame.size() - 1];
+		unsigned long expected = (frame.back() + 3) * 260 + OOK_PULSE_TRIM + 10000UL;
+		OOK_CHECK(gap >= expected - EDGE_TOLERANCE && gap <= expected + 100);
+	}
+}
+
+// The RFM69 is in continuous OOK transmit mode while edges are output and its registers are restored afterwards
+OOK_TEST(registersSwitchedAndRestored)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	radio.regs[REG_OPMODE] = RF_OPMODE_RECEIVER;
+	radio.regs[REG_DATAMODUL] = 0x00;
+	byte saved[0x80];
+	memcpy(saved, radio.regs, sizeof(saved));
+	ook.setOokParams(260, 2, 5);
+	ook.sendKakuNew(radio, 1332798, 1, true, false, 0);
+	byte opmode = saved[REG_OPMODE], datamodul = saved[REG_DATAMODUL];
+	bool edgesInTransmit = true;
+	const std::vector<OokSimEvent> &trace = ookSimTrace();
+	for (size_t i = 0; i < trace.size(); i++)
+	{
+		const OokSimEvent &event = trace[i];
+		if (event.kind == OOK_SIM_REG_WRITE && event.addr == REG_OPMODE) opmode = event.value;
+		if (event.kind == OOK_SIM_REG_WRITE && event.addr == REG_DATAMODUL) datamodul = event.value;
+		if (event.kind == OOK_SIM_PIN && event.value == HIGH) edgesInTransmit &= opmode == RF_OPMODE_TRANSMITTER &&
+			datamodul == (RF_DATAMODUL_DATAMODE_CONTINUOUSNOBSYNC | RF_DATAMODUL_MODULATIONTYPE_OOK);
+	}
+	OOK_CHECK(edgesInTransmit);
+	OOK_CHECK(memcmp(saved, radio.regs, sizeof(saved)) == 0);
+	OOK_CHECK(ookSimPinLevel(RF69_OOK_PIN) == LOW);
+}
+
+// airtime() matches the sending time, which also waits the repeat delay after the last repeat
+OOK_TEST(airtimeMatchesTrace)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	ook.setOokParams(260, 3, 10);
+	OokFrame frame;
+	ook.encodeKakuNew(frame, 1332798, 1, true, false, 0);
+	unsigned long start = ookSimNow();
+	ook.sendFrame(radio, frame);
+	unsigned long elapsed = ookSimNow() - start;
+	OOK_CHECK(elapsed >= ook.airtime(frame) + frame.repDly * 1000UL);
+	OOK_CHECK(elapsed <= ook.airtime(frame) + frame.repDly * 1000UL + 1000);
+}
@@ -0,0 +1,45 @@
+/**********************************************************************************************************************
+* test_main.cpp - Run the RFM69OOK host test cases, optionally only those whose name contains the first argument
+/**********************************************************************************************************************/
+#include <string.h>
+#include "OokTest.h"
+#include <RFM69OOK.h>
+#include "OokSim.h"
+
+boolean RFM69OOK_DEBUG = false;				// Debug option normally defined by the sketch
+
+OokTestCase *ookTestCases = NULL;
+unsigned long ookTestFailures = 0;
+
+OokTestCase::OokTestCase(const char *name, void (*function)()) : name(name), function(function), next(NULL)
+{
+	OokTestCase **last = &ookTestCases;					// Keep the definition order
+	while (*last) last = &(*last)->next;
+	*last = this;
+}
+
+bool ookTestCheck(bool condition, const char *text, const char *file, int line)
+{
+	if (condition) return true;
+	ookTestFailures++;
+	printf("  FAILED %s:%d: %s\n", file, line, text);
+	return false;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int cases = 0;
+	unsigned int failed = 0;
+	for (OokTestCase *test = ookTestCases; test; test = test->next)
+	{
+		if (argc > 1 && !strstr(test->name, argv[1])) continue;
+		unsigned long failures = ookTestFailures;
+		ookSimReset();
+		test->function();
+		cases++;
+		if (ookTestFailures != failures) failed++;
+		printf("%-6s %s\n", ookTestFailures != failures ? "FAIL" : "ok", test->name);
+	}
+	printf("%u test cases, %u failed, %lu failed checks\n", cases, failed, ookTestFailures);
+	return failed ? 1 : 0;
+}
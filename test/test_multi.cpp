@@ -0,0 +1,90 @@
+/**********************************************************************************************************************
+* test_multi.cpp - RFM69OOKMulti: the edges of frames of different protocols and repeats are output from one merged
+* schedule, each one at its own nominal time, so that the sending takes about the time of the longest frame
+/**********************************************************************************************************************/
+#include <RFM69OOK.h>
+#include <vector>
+#include "OokTest.h"
+
+// Edge tolerance against the nominal time (us): edges falling together are output one after the other
+#define EDGE_TOLERANCE        6
+#define PIN_B                 5
+
+struct Edge {
+	unsigned long time;						// Nominal time from the start of the sending (us)
+	uint8_t level;
+};
+typedef std::vector<Edge> Edges;
+
+// Nominal edges of a frame with its repeats: HIGH levels OOK_HIGH_TRIM us shorter, repDly ms after each repeat
+static Edges edgesOf(const OokFrame &frame)
+{
+	Edges edges;
+	unsigned long pos = 0;
+	for (byte repeat = 0; repeat < frame.repeats; repeat++)
+	{
+		for (byte i = 0; i + 1 < frame.length; i += 2)
+		{
+			unsigned int high = frame.dur[i];
+			if (high)														// No edge for a 0 HIGH duration
+			{
+				Edge rise = { pos, HIGH }, fall = { pos + high - OOK_HIGH_TRIM(high), LOW };
+				edges.push_back(rise);
+				edges.push_back(fall);
+			}
+			pos += high + frame.dur[i + 1];
+		}
+		pos += frame.repDly * 1000UL;
+	}
+	return edges;
+}
+
+// A KAKU New and a KAKU Old channel with different pulse times and repeats: every edge is output at its nominal
+// time, the edges of both channels alternate in deadline order and the sending lasts about the longest channel
+OOK_TEST(multiEdgesInterleaved)
+{
+	RFM69 radioA, radioB;
+	RFM69OOK ookA, ookB;
+	ookB.setOokPin(PIN_B);
+	ookA.setOokParams(260, 2, 10);
+	ookB.setOokParams(375, 3, 5);
+	OokFrame frameA, frameB;
+	ookA.encodeKakuNew(frameA, 1332798, 1, true, false, 0);
+	ookB.encodeKakuOld(frameB, 'C', 2, true);
+	RFM69OOKMulti multi;
+	OOK_CHECK(multi.add(ookA, radioA, frameA));
+	OOK_CHECK(multi.add(ookB, radioB, frameB));
+	unsigned long start = ookSimNow();
+	multi.send();
+	unsigned long elapsed = ookSimNow() - start;
+	Edges nominal[2] = { edgesOf(frameA), edgesOf(frameB) };
+	size_t next[2] = { 0, 0 };
+	unsigned long origin = 0, previous = 0;
+	unsigned int late = 0, disordered = 0, switches = 0;
+	int last = -1;
+	const std::vector<OokSimEvent> &trace = ookSimTrace();
+	for (size_t i = 0; i < trace.size(); i++)
+	{
+		const OokSimEvent &event = trace[i];
+		if (event.kind != OOK_SIM_PIN) continue;
+		int channel = event.addr == PIN_B ? 1 : 0;
+		if (!OOK_CHECK(next[channel] < nominal[channel].size())) return;
+		const Edge &edge = nominal[channel][next[channel]++];
+		if (!origin) origin = event.time - edge.time;					// Start of the merged schedule
+		unsigned long time = event.time - origin;
+		if (edge.level != event.value || time + EDGE_TOLERANCE < edge.time || time > edge.time + EDGE_TOLERANCE) late++;
+		if (edge.time + EDGE_TOLERANCE < previous) disordered++;
+		previous = edge.time;
+		if (last >= 0 && last != channel) switches++;
+		last = channel;
+	}
+	OOK_CHECK(next[0] == nominal[0].size() && next[1] == nominal[1].size());
+	OOK_CHECK(late == 0);
+	OOK_CHECK(disordered == 0);
+	OOK_CHECK(switches > 100);											// Not one frame after the other
+	unsigned long timeA = ookA.airtime(frameA) + frameA.repDly * 1000UL;
+	unsigned long timeB = ookB.airtime(frameB) + frameB.repDly * 1000UL;
+	unsigned long longest = timeA > timeB ? timeA : timeB;
+	OOK_CHECK(elapsed >= longest && elapsed <= longest + 1000);
+	OOK_CHECK(elapsed < (timeA + timeB) * 2 / 3);
+}
@@ -0,0 +1,94 @@
+/**********************************************************************************************************************
+* test_protocols.cpp - Edge timings of the descriptor protocols at short pulse times, where a HIGH level of one pulse
+* time is not longer than OOK_PULSE_TRIM: each HIGH level is OOK_HIGH_TRIM us shorter and each LOW level as much longer
+/**********************************************************************************************************************/
+#include <RFM69OOK.h>
+#include <vector>
+#include "OokTest.h"
+
+// Edge tolerance against the frame durations (us): clock tick plus the edge lead
+#define EDGE_TOLERANCE        3
+#define SHORT_PERIOD          100
+
+// Check the durations recorded on a pin against one sending of a frame, the last LOW level excluded
+static void checkShortFrame(uint8_t pin, const OokFrame &frame)
+{
+	std::vector<unsigned long> durations = ookSimDurations(pin);
+	if (!OOK_CHECK(durations.size() == frame.length - 1u)) return;
+	unsigned int bad = 0;
+	for (size_t i = 0; i < durations.size(); i++)
+	{
+		unsigned int high = frame.dur[i & ~1];
+		unsigned long expected = (i & 1) ? frame.dur[i] + OOK_HIGH_TRIM(high) : high - OOK_HIGH_TRIM(high);
+		if (durations[i] + EDGE_TOLERANCE < expected || durations[i] > expected + EDGE_TOLERANCE) bad++;
+	}
+	OOK_CHECK(bad == 0);
+}
+
+// PT2262 and EV1527 at a 100 us pulse time keep a HIGH level on every pulse with the blocking sending
+OOK_TEST(shortPeriodSend)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	ook.setOokParams(SHORT_PERIOD, 1, 5);
+	OokFrame frame;
+	ook.encode(frame, OOK_PROTO_PT2262, 0x5A3, 0x00C);
+	ook.sendFrame(radio, frame);
+	checkShortFrame(RF69_OOK_PIN, frame);
+	ookSimReset();
+	ook.encode(frame, OOK_PROTO_EV1527, 0xABCDE5);
+	ook.sendFrame(radio, frame);
+	checkShortFrame(RF69_OOK_PIN, frame);
+}
+
+// The timer intervals of an asynchronous sending at a 100 us pulse time follow the frame: no wrapped interval
+OOK_TEST(shortPeriodAsync)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	OokVirtualTimer timer;
+	ook.setOokTimer(timer);
+	ook.setOokParams(SHORT_PERIOD, 1, 5);
+	OokFrame frame;
+	ook.encode(frame, OOK_PROTO_EV1527, 0xABCDE5);
+	unsigned long start = ookSimNow();
+	OOK_CHECK(ook.beginSendFrame(radio, frame));
+	while (ook.isBusy() && ookSimNow() - start < 10 * ook.airtime(frame))
+	{
+		ookSimAdvance(1);
+		timer.advance(1);
+	}
+	OOK_CHECK(!ook.isBusy());
+	checkShortFrame(RF69_OOK_PIN, frame);
+}
+
+// Frames at a 100 us pulse time sent together by RFM69OOKMulti keep their HIGH levels
+OOK_TEST(shortPeriodMulti)
+{
+	RFM69 radioA, radioB;
+	RFM69OOK ookA, ookB;
+	ookB.setOokPin(5);
+	ookA.setOokParams(SHORT_PERIOD, 1, 5);
+	ookB.setOokParams(SHORT_PERIOD, 1, 5);
+	OokFrame frameA, frameB;
+	ookA.encode(frameA, OOK_PROTO_PT2262, 0x5A3, 0x00C);
+	ookB.encode(frameB, OOK_PROTO_EV1527, 0xABCDE5);
+	RFM69OOKMulti multi;
+	OOK_CHECK(multi.add(ookA, radioA, frameA));
+	OOK_CHECK(multi.add(ookB, radioB, frameB));
+	multi.send();
+	checkShortFrame(RF69_OOK_PIN, frameA);
+	checkShortFrame(5, frameB);
+}
+
+// dryRun measures the edges of a 100 us frame against the same clamped trim
+OOK_TEST(shortPeriodDryRun)
+{
+	RFM69OOK ook;
+	ook.setOokParams(SHORT_PERIOD, 1, 5);
+	OokFrame frame;
+	ook.encode(frame, OOK_PROTO_PT2262, 0x5A3, 0x00C);
+	OokEdgeErrors errors = ook.dryRun(frame);
+	OOK_CHECK(errors.edges == frame.length);
+	OOK_CHECK(errors.maxLateUsec <= EDGE_TOLERANCE);
+}
@@ -0,0 +1,159 @@
+/**********************************************************************************************************************
+* test_receiver.cpp - RFM69OOKReceiver fed with the levels of frames encoded by RFM69OOK, replayed on the DIO2 input
+*
+* Each level change calls the pin change interrupt handler attached by begin() (see ookSimInput); receiveDone() is
+* called after each edge like a main loop would, unless the ring is to be overrun.
+/**********************************************************************************************************************/
+#include <RFM69OOK.h>
+#include "OokTest.h"
+
+// Replay the levels of one encoded frame on the DIO2 input, HIGH levels skew us shorter and LOW levels skew us longer
+// (the balance of a real receiver), decoding after each edge when requested. Returns the number of new messages.
+static unsigned int replay(RFM69OOKReceiver &rx, const OokFrame &frame, int skew = 0, bool decode = true)
+{
+	unsigned int received = 0;
+	for (byte i = 0; i < frame.length; i++)
+	{
+		if (!frame.dur[i]) continue;										// Start bit of Old Kaku and Cogex
+		ookSimInput(RF69_OOK_PIN, i & 1 ? LOW : HIGH);
+		ookSimAdvance(i & 1 ? frame.dur[i] + skew : frame.dur[i] - skew);
+		if (decode && rx.receiveDone()) received++;
+	}
+	return received;
+}
+// Close the last LOW level of a replayed frame with a silence (also the quiet channel before a first frame), returns
+// the number of new messages
+static unsigned int silence(RFM69OOKReceiver &rx)
+{
+	ookSimAdvance(OOK_RX_TIMEOUT + 1000);
+	return rx.receiveDone() ? 1 : 0;
+}
+
+// A dimmed New frame gives the send function fields, a group frame its group option
+OOK_TEST(rxKakuNewDimmed)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	RFM69OOKReceiver rx;
+	OOK_CHECK(rx.begin(radio));
+	silence(rx);
+	ook.setOokParams(260, 1, 5);
+	OokFrame frame;
+	ook.encodeKakuNew(frame, 1332798, 3, true, false, 9);
+	OOK_CHECK(replay(rx, frame) + silence(rx) == 1);
+	const OokMessage &message = rx.getMessage();
+	OOK_CHECK(message.protocol == OOK_KAKU_NEW && message.addr == 1332798 && message.unit == 3);
+	OOK_CHECK(message.on && !message.group && message.dimLevel == 9 && message.repeats == 1);
+	ook.encodeKakuNew(frame, 4242, 1, false, true, 0);
+	OOK_CHECK(replay(rx, frame) + silence(rx) == 1);
+	OOK_CHECK(message.addr == 4242 && message.unit == 0 && !message.on && message.group && message.dimLevel == 0);
+	rx.end();
+}
+
+// Identical frames within OOK_RX_REPEAT_MS are counted as repeats of one message, a later one is a new message
+OOK_TEST(rxRepeatsCounted)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	RFM69OOKReceiver rx;
+	OOK_CHECK(rx.begin(radio));
+	silence(rx);
+	ook.setOokParams(260, 1, 5);
+	OokFrame frame;
+	ook.encodeKakuOld(frame, 'C', 2, true);
+	unsigned int received = 0;
+	for (byte repeat = 0; repeat < 4; repeat++)
+	{
+		received += replay(rx, frame);
+		ookSimAdvance(frame.repDly * 1000UL);
+	}
+	received += silence(rx);
+	OOK_CHECK(received == 1);
+	OOK_CHECK(rx.getMessage().repeats == 4);
+	OOK_CHECK(rx.getRxStats().frames == 4);
+	OOK_CHECK(rx.getMessage().addr == 'C' && rx.getMessage().unit == 2 && rx.getMessage().on);
+	ookSimAdvance(OOK_RX_REPEAT_MS * 1000UL);
+	OOK_CHECK(replay(rx, frame) + silence(rx) == 1);
+	OOK_CHECK(rx.getMessage().repeats == 1);
+	rx.end();
+}
+
+// The pulse time is measured on the sync pulse whatever the HIGH/LOW balance, for Old and Cogex frames
+OOK_TEST(rxPeriodMeasuredOnSync)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	RFM69OOKReceiver rx;
+	OOK_CHECK(rx.begin(radio));
+	silence(rx);
+	ook.setOokParams(375, 1, 5);
+	OokFrame frame;
+	ook.encodeKakuOld(frame, 'P', 16, false);
+	OOK_CHECK(replay(rx, frame, 100) + silence(rx) == 1);
+	OOK_CHECK(rx.getMessage().protocol == OOK_KAKU_OLD);
+	OOK_CHECK(rx.getMessage().addr == 'P' && rx.getMessage().unit == 16 && !rx.getMessage().on);
+	OOK_CHECK_NEAR(rx.getMessage().periodusec, 375, 1);
+	rx.end();
+	rx.setRxProtocols(_BV(OOK_KAKU_COGEX));
+	OOK_CHECK(rx.begin(radio));
+	silence(rx);
+	ook.setOokParams(300, 1, 5);
+	ook.encodeKakuCogex(frame, 5, 3, true);
+	OOK_CHECK(replay(rx, frame, -60) + silence(rx) == 1);
+	OOK_CHECK(rx.getMessage().protocol == OOK_KAKU_COGEX);
+	OOK_CHECK(rx.getMessage().addr == 5 && rx.getMessage().unit == 3 && rx.getMessage().on);
+	OOK_CHECK_NEAR(rx.getMessage().periodusec, 300, 1);
+	rx.end();
+}
+
+// Edges beyond a full ring are counted as overruns and restart the decoders: the corrupted frame is not reported,
+// the next one is
+OOK_TEST(rxRingOverrun)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	RFM69OOKReceiver rx;
+	OOK_CHECK(rx.begin(radio));
+	silence(rx);
+	ook.setOokParams(260, 1, 5);
+	OokFrame frame;
+	ook.encodeKakuNew(frame, 1332798, 1, true, false, 0);
+	replay(rx, frame, 0, false);
+	OOK_CHECK(silence(rx) == 0);
+	OOK_CHECK(rx.getRxStats().overruns == frame.length - (OOK_RX_RING_SIZE - 1u));
+	OOK_CHECK(rx.getRxStats().edges == OOK_RX_RING_SIZE - 1);
+	OOK_CHECK(rx.getRxStats().frames == 0);
+	OOK_CHECK(replay(rx, frame) + silence(rx) == 1);
+	OOK_CHECK(rx.getMessage().addr == 1332798 && rx.getMessage().unit == 1);
+	OOK_CHECK(rx.getRxStats().overruns == frame.length - (OOK_RX_RING_SIZE - 1u));
+	rx.end();
+}
+
+// Malformed trains give no message: a wrong symbol, a truncated frame, an Old frame without its fixed bits and a
+// pulse time out of the receiver range. A valid frame after a truncated one is received.
+OOK_TEST(rxMalformedRejected)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	RFM69OOKReceiver rx;
+	OOK_CHECK(rx.begin(radio));
+	silence(rx);
+	ook.setOokParams(260, 1, 5);
+	OokFrame frame;
+	ook.encodeKakuNew(frame, 1332798, 1, true, false, 0);
+	OokFrame wrong = frame;
+	wrong.dur[2 + 4 * 10 + 1] = wrong.dur[2 + 4 * 10 + 3] = 260;			// Bit 10 sent as 1,1,1,1
+	OOK_CHECK(replay(rx, wrong) + silence(rx) == 0);
+	OokFrame truncated = frame;
+	truncated.length = 100;
+	OOK_CHECK(replay(rx, truncated) + silence(rx) == 0);
+	OOK_CHECK(replay(rx, frame) + silence(rx) == 1);
+	ook.encode(frame, OOK_PROTO_KAKU_OLD, 0x812);
+	OOK_CHECK(replay(rx, frame) + silence(rx) == 0);
+	OOK_CHECK(rx.getRxStats().frames == 2);								// Decoded but not a KAKU message
+	ook.setOokParams(OOK_RX_MAX_PERIOD + 200, 1, 5);
+	ook.encodeKakuNew(frame, 1332798, 1, true, false, 0);
+	OOK_CHECK(replay(rx, frame) + silence(rx) == 0);
+	OOK_CHECK(rx.getMessage().repeats == 1);
+	rx.end();
+}
@@ -0,0 +1,64 @@
+/**********************************************************************************************************************
+* test_regcache.cpp - RFM69 register shadow cache: register accesses of repeated sendings with the cache off and on,
+* counted in the register trace, and the registers left by the cached sendings
+/**********************************************************************************************************************/
+#include <RFM69OOK.h>
+#include <vector>
+#include "OokTest.h"
+
+// Register accesses of one KAKU New sending
+struct Accesses {
+	unsigned long reads;
+	unsigned long writes;
+	std::vector<unsigned long> durations;	// DIO2 edges of the sending
+};
+static Accesses sendCounted(RFM69OOK &ook, RFM69 &radio)
+{
+	ookSimReset();
+	ook.sendKakuNew(radio, 1332798, 1, true, false, 0);
+	Accesses accesses = { ookSimCount(OOK_SIM_REG_READ), ookSimCount(OOK_SIM_REG_WRITE),
+		ookSimDurations(RF69_OOK_PIN) };
+	return accesses;
+}
+
+// A repeated sending takes 5 reads and 7 writes without the cache, 1 read and 5 writes with it (the RX restart write,
+// the OPMODE read after the channel access, the mode switch and restore writes), with the same edges and registers
+OOK_TEST(regCacheSavesAccesses)
+{
+	RFM69 plainRadio, cachedRadio;
+	RFM69OOK plain, cached;
+	plainRadio.regs[REG_OPMODE] = cachedRadio.regs[REG_OPMODE] = RF_OPMODE_RECEIVER;
+	plain.setOokParams(260, 1, 5);
+	cached.setOokParams(260, 1, 5);
+	cached.setRegCache(true);
+	sendCounted(plain, plainRadio);
+	Accesses first = sendCounted(cached, cachedRadio);
+	OOK_CHECK(first.reads == 5);											// Cache filled by the first sending
+	for (byte repeat = 0; repeat < 3; repeat++)
+	{
+		Accesses off = sendCounted(plain, plainRadio);
+		Accesses on = sendCounted(cached, cachedRadio);
+		OOK_CHECK(off.reads == 5 && off.writes == 7);
+		OOK_CHECK(on.reads == 1 && on.writes == 5);
+		OOK_CHECK(on.durations == off.durations);
+		OOK_CHECK(memcmp(plainRadio.regs, cachedRadio.regs, sizeof(plainRadio.regs)) == 0);
+	}
+}
+
+// A register changed through the RFM69 instance is restored once the cache is invalidated
+OOK_TEST(regCacheInvalidated)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	ook.setOokParams(260, 1, 5);
+	ook.setRegCache(true);
+	sendCounted(ook, radio);
+	radio.writeReg(REG_BITRATEMSB, 0x02);									// 55.5 kbps FSK set by the application
+	radio.writeReg(REG_BITRATELSB, 0x40);
+	ook.invalidateRegCache();
+	Accesses accesses = sendCounted(ook, radio);
+	OOK_CHECK(accesses.reads == 5);
+	OOK_CHECK(radio.regs[REG_BITRATEMSB] == 0x02 && radio.regs[REG_BITRATELSB] == 0x40);
+	accesses = sendCounted(ook, radio);
+	OOK_CHECK(accesses.reads == 1 && accesses.writes == 5);
+}
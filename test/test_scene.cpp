@@ -0,0 +1,87 @@
+/**********************************************************************************************************************
+* test_scene.cpp - RFM69OOKScene sendings: register cache after a dropped batch, no trace events while planning
+/**********************************************************************************************************************/
+#include <RFM69OOK.h>
+#include "OokTest.h"
+
+// RFM69 library receiving during the channel access: the packet handling leaves another modulation set
+static bool changeModulation(RFM69 &radio)
+{
+	radio.regs[REG_DATAMODUL] = RF_DATAMODUL_MODULATIONTYPE_OOK;
+	return false;
+}
+
+// A scene dropped by the channel access forgets the cached registers: the next sending restores the current ones
+OOK_TEST(sceneDropInvalidatesRegCache)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	RFM69OOKScene scene;
+	ook.setRegCache(true);
+	ook.setOokParams(260, 1, 5);
+	scene.set(OOK_KAKU_NEW, 1332798, 1, true);
+	scene.send(ook, radio);											// Cache filled by a sent scene
+	OOK_CHECK(ook.lastChannelAccess() == OOK_CHANNEL_READY);
+	ook.setChannelAccess(0, 10, OOK_CSMA_DROP);
+	radio.rssi = -50;
+	radio.receiveHook = changeModulation;
+	scene.set(OOK_KAKU_NEW, 1332798, 2, true);
+	scene.send(ook, radio);
+	OOK_CHECK(ook.lastChannelAccess() == OOK_CHANNEL_DROPPED);
+	OOK_CHECK(ook.queued() == 0);
+	radio.rssi = -100;
+	radio.receiveHook = NULL;
+	byte saved[0x80];
+	memcpy(saved, radio.regs, sizeof(saved));
+	scene.send(ook, radio);
+	OOK_CHECK(ook.lastChannelAccess() == OOK_CHANNEL_READY);
+	OOK_CHECK(radio.regs[REG_DATAMODUL] == RF_DATAMODUL_MODULATIONTYPE_OOK);
+	OOK_CHECK(memcmp(saved, radio.regs, sizeof(saved)) == 0);
+}
+
+// A house is evaluated once over all its devices: a later device must not choose a group switching earlier ones
+OOK_TEST(sceneGroupDecidedOncePerHouse)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	RFM69OOKScene scene;
+	ook.setOokParams(260, 1, 5);
+	scene.setRefreshTtl(3600000UL);
+	for (byte unit = 0; unit < 3; unit++) scene.set(OOK_KAKU_NEW, 1332798, unit, false);
+	scene.send(ook, radio);											// Units 0-2 known OFF
+	scene.set(OOK_KAKU_NEW, 1332798, 1, true);
+	scene.set(OOK_KAKU_NEW, 1332798, 2, true);
+	const OokScenePlan &plan = scene.compile(ook);					// Group ON + unit 0 OFF is not shorter
+	OOK_CHECK(plan.groups == 0);
+	if (OOK_CHECK(plan.commands == 2))
+	{
+		OOK_CHECK(!plan.command[0].group && plan.command[0].unit == 1 && plan.command[0].on);
+		OOK_CHECK(!plan.command[1].group && plan.command[1].unit == 2 && plan.command[1].on);
+	}
+	scene.send(ook, radio);
+	scene.set(OOK_KAKU_NEW, 1332798, 0, false);						// Still known OFF: nothing to send
+	OOK_CHECK(scene.compile(ook).commands == 0);
+	OOK_CHECK(scene.compile(ook).skipped == 1);
+}
+
+#if OOK_TRACE_SIZE
+// Planning a scene encodes frames without sending them: only the sending is traced
+OOK_TEST(sceneCompileNotTraced)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	RFM69OOKScene scene;
+	Stream sink(NULL);
+	RFM69OOK_DEBUG = true;
+	RFM69OOK::dumpTrace(sink);
+	scene.set(OOK_KAKU_NEW, 1332798, 1, true);
+	scene.set(OOK_KAKU_NEW, 1332798, 2, true);
+	scene.set(OOK_KAKU_OLD, 'C', 3, false);
+	scene.compile(ook);
+	OOK_CHECK(RFM69OOK::dumpTrace(sink) == 0);
+	OokFrame frame;
+	ook.encodeKakuOld(frame, 'C', 3, false);
+	OOK_CHECK(RFM69OOK::dumpTrace(sink) == 1);
+	RFM69OOK_DEBUG = false;
+}
+#endif
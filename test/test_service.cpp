@@ -0,0 +1,165 @@
+/**********************************************************************************************************************
+* test_service.cpp - RFM69OOKService under concurrent producers: std::thread tasks submit commands while a worker
+* thread polls the service. Only the worker uses the RFM69 instance and the simulation clock.
+/**********************************************************************************************************************/
+#include <RFM69OOK.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "OokTest.h"
+
+#if OOK_SERVICE
+#define STRESS_PRODUCERS      4
+#define STRESS_COMMANDS       150					// Commands submitted by each producer
+
+// Command of a producer, terminated by the worker when run or by the producer when refused on a full queue
+struct StressCommand {
+	unsigned int id;								// Producer << 16 | rank
+	std::atomic<unsigned int> runs;					// Times the worker terminated the command
+	std::atomic<unsigned int> refused;				// Times the command was refused
+	boolean restored;								// Registers found restored once the command was terminated
+	OokCompletion completion;
+	StressCommand();
+};
+struct StressWorker {
+	RFM69 *radio;
+	std::thread::id thread;							// Worker thread
+	byte saved[0x80];								// Registers before the service started
+	std::vector<unsigned int> order;				// Ids in running order (worker only)
+};
+static StressWorker worker;
+
+static void stressCompleted(OokCompletion &, void *context)
+{
+	StressCommand &command = *(StressCommand *) context;
+	if (std::this_thread::get_id() != worker.thread)
+	{
+		command.refused++;
+		return;
+	}
+	command.runs++;
+	command.restored = memcmp(worker.saved, worker.radio->regs, sizeof(worker.saved)) == 0;
+	worker.order.push_back(command.id);
+}
+StressCommand::StressCommand() : id(0), runs(0), refused(0), restored(false), completion(stressCompleted, this)
+{
+}
+// Radio function changing a register and restoring it, like an FSK sending would
+static void stressRadio(RFM69 &radio, void *)
+{
+	byte length = radio.readReg(REG_PAYLOADLENGTH);
+	radio.writeReg(REG_PAYLOADLENGTH, 0x20);
+	radio.writeReg(REG_PAYLOADLENGTH, length);
+}
+
+// A full queue refuses the command at once and terminates its completion as dropped, other priorities still accept
+OOK_TEST(serviceQueueRejectsWhenFull)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	RFM69OOKService service(ook, radio);
+	for (unsigned int i = 0; i < OOK_SERVICE_QUEUE; i++)
+		OOK_CHECK(service.submitRadio(stressRadio, NULL, OOK_PRIORITY_LOW));
+	OokCompletion refused;
+	OOK_CHECK(!service.submitRadio(stressRadio, NULL, OOK_PRIORITY_LOW, &refused));
+	OOK_CHECK(refused.done() && refused.result() == OOK_CHANNEL_DROPPED);
+	OOK_CHECK(service.rejected() == 1);
+	OOK_CHECK(service.submitRadio(stressRadio, NULL, OOK_PRIORITY_HIGH));
+	unsigned int polled = 0;
+	while (service.poll()) polled++;
+	OOK_CHECK(polled == OOK_SERVICE_QUEUE + 1);
+	OOK_CHECK(service.submitRadio(stressRadio, NULL, OOK_PRIORITY_LOW));
+	OOK_CHECK(service.poll() && !service.poll());
+}
+
+// Producers racing on a queue without worker: exactly OOK_SERVICE_QUEUE commands are accepted
+OOK_TEST(serviceQueueBoundedUnderContention)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	RFM69OOKService service(ook, radio);
+	std::atomic<unsigned int> accepted(0);
+	std::vector<std::thread> producers;
+	for (unsigned int p = 0; p < STRESS_PRODUCERS; p++) producers.push_back(std::thread([&]() {
+		for (unsigned int i = 0; i < OOK_SERVICE_QUEUE; i++)
+			if (service.submitRadio(stressRadio, NULL, OOK_PRIORITY_NORMAL)) accepted++;
+	}));
+	for (size_t p = 0; p < producers.size(); p++) producers[p].join();
+	OOK_CHECK(accepted == OOK_SERVICE_QUEUE);
+	OOK_CHECK(service.rejected() == (STRESS_PRODUCERS - 1) * OOK_SERVICE_QUEUE);
+}
+
+// Every command submitted by concurrent producers is run once, in order within a producer and priority, and finds
+// the registers restored by the previous one
+OOK_TEST(serviceStressRunsEachCommandOnce)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	RFM69OOKService service(ook, radio);
+	radio.regs[REG_OPMODE] = RF_OPMODE_RECEIVER;
+	worker.radio = &radio;
+	memcpy(worker.saved, radio.regs, sizeof(worker.saved));
+	worker.order.clear();
+	static StressCommand commands[STRESS_PRODUCERS][STRESS_COMMANDS];
+	std::atomic<unsigned int> running(STRESS_PRODUCERS);
+	std::thread polling([&]() {
+		for (;;)
+		{
+			boolean last = running == 0;						// Read first: no submit after it
+			if (service.poll()) continue;
+			if (last) break;
+			std::this_thread::yield();
+		}
+	});
+	worker.thread = polling.get_id();								// Before any command is submitted
+	std::vector<std::thread> producers;
+	for (unsigned int p = 0; p < STRESS_PRODUCERS; p++) producers.push_back(std::thread([&, p]() {
+		for (unsigned int i = 0; i < STRESS_COMMANDS; i++)
+		{
+			StressCommand &command = commands[p][i];
+			command.id = p << 16 | i;
+			byte priority = i % OOK_PRIORITIES;
+			OokCommand kaku = { 1332798, 120, 1, 0, (byte) (i % 6 ? OOK_KAKU_NEW : OOK_KAKU_OLD), (byte) (p + 1), 0, 
+				(i & 1) != 0, false };
+			if (kaku.protocol == OOK_KAKU_OLD) kaku.addr = 'A' + p;
+			while (!(i % 3 ? service.submitRadio(stressRadio, NULL, priority, &command.completion) :
+				service.submit(kaku, priority, &command.completion)))
+				std::this_thread::yield();							// Full: submit again once the worker frees a cell
+		}
+		running--;
+	}));
+	for (size_t p = 0; p < producers.size(); p++) producers[p].join();
+	polling.join();
+	unsigned int once = 0, restored = 0, sent = 0, refused = 0;
+	for (unsigned int p = 0; p < STRESS_PRODUCERS; p++)
+		for (unsigned int i = 0; i < STRESS_COMMANDS; i++)
+		{
+			StressCommand &command = commands[p][i];
+			if (command.runs == 1) once++;
+			if (command.restored) restored++;
+			refused += command.refused;
+			if (command.completion.done() && (command.completion.result() == OOK_CHANNEL_READY ||
+				command.completion.result() == OOK_CHANNEL_FORCED)) sent++;
+		}
+	OOK_CHECK(once == STRESS_PRODUCERS * STRESS_COMMANDS);
+	OOK_CHECK(restored == STRESS_PRODUCERS * STRESS_COMMANDS);
+	OOK_CHECK(sent == STRESS_PRODUCERS * STRESS_COMMANDS);
+	OOK_CHECK(worker.order.size() == STRESS_PRODUCERS * STRESS_COMMANDS);
+	OOK_CHECK(service.rejected() == refused);
+	OOK_CHECK(memcmp(worker.saved, radio.regs, sizeof(worker.saved)) == 0);
+	unsigned int inOrder = 0;										// FIFO within a producer and a priority
+	for (size_t i = 0; i < worker.order.size(); i++)
+	{
+		unsigned int id = worker.order[i];
+		boolean later = true;
+		for (size_t j = i + 1; j < worker.order.size(); j++)
+		{
+			unsigned int next = worker.order[j];
+			if (next >> 16 == id >> 16 && (next & 0xFFFF) % OOK_PRIORITIES == (id & 0xFFFF) % OOK_PRIORITIES &&
+				(next & 0xFFFF) < (id & 0xFFFF)) later = false;
+		}
+		if (later) inOrder++;
+	}
+	OOK_CHECK(inOrder == worker.order.size());
+}
+#endif
@@ -0,0 +1,107 @@
+/**********************************************************************************************************************
+* test_stats.cpp - Transmit telemetry of getStats: per protocol frame, repeat and transmit time counters, the clear
+* channel wait histogram and resetStats
+/**********************************************************************************************************************/
+#include <RFM69OOK.h>
+#include "OokTest.h"
+
+#if OOK_STATS
+// Transmit time tolerance (us): register accesses and clock ticks around the frame repeats
+#define TX_TOLERANCE          1000
+
+// Send an encoded frame and return its expected transmit time, repeat delays included
+static unsigned long sendTimed(RFM69OOK &ook, RFM69 &radio, const OokFrame &frame)
+{
+	ook.sendFrame(radio, frame);
+	return ook.airtime(frame) + frame.repDly * 1000UL;
+}
+
+// Frames of each protocol are counted in their slot with their repeats and transmit time, and in the totals
+OOK_TEST(statsPerProtocol)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	OokFrame frame;
+	unsigned long txNew = 0, txOld = 0, txOther = 0;
+	ook.setOokParams(260, 2, 5);
+	ook.encodeKakuNew(frame, 1332798, 1, true, false, 0);
+	txNew += sendTimed(ook, radio, frame);
+	ook.encodeKakuNew(frame, 1332798, 2, false, false, 0);
+	txNew += sendTimed(ook, radio, frame);
+	ook.setOokParams(375, 3, 10);
+	ook.encodeKakuOld(frame, 'B', 3, true);
+	txOld += sendTimed(ook, radio, frame);
+	ook.setOokParams(350, 4, 5);
+	ook.encode(frame, OOK_PROTO_PT2262, 0x5A3);
+	txOther += sendTimed(ook, radio, frame);
+	const OokStats &stats = ook.getStats();
+	const OokProtocolStats &kakuNew = stats.protocols[OOK_KAKU_NEW];
+	const OokProtocolStats &kakuOld = stats.protocols[OOK_KAKU_OLD];
+	const OokProtocolStats &other = stats.protocols[OOK_OTHER];
+	OOK_CHECK(kakuNew.frames == 2 && kakuNew.repeats == 4);
+	OOK_CHECK(kakuOld.frames == 1 && kakuOld.repeats == 3);
+	OOK_CHECK(other.frames == 1 && other.repeats == 4);
+	OOK_CHECK(stats.protocols[OOK_KAKU_COGEX].frames == 0 && stats.protocols[OOK_KAKU_COGEX].txOnUsec == 0);
+	OOK_CHECK_NEAR(kakuNew.txOnUsec, txNew, 2 * TX_TOLERANCE);
+	OOK_CHECK_NEAR(kakuOld.txOnUsec, txOld, TX_TOLERANCE);
+	OOK_CHECK_NEAR(other.txOnUsec, txOther, TX_TOLERANCE);
+	OOK_CHECK(stats.total.frames == 4 && stats.total.repeats == 11);
+	OOK_CHECK(stats.total.txOnUsec == kakuNew.txOnUsec + kakuOld.txOnUsec + other.txOnUsec);
+	OOK_CHECK(stats.regReads == ookSimCount(OOK_SIM_REG_READ));
+	OOK_CHECK(stats.regWrites == ookSimCount(OOK_SIM_REG_WRITE));
+}
+
+// Clear channel waits fall in the 0 ms, 1, 10, 100 ms and longer buckets; accesses reaching their limit are timeouts,
+// also when the frame is dropped
+OOK_TEST(statsCsmaHistogram)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	ook.setOokParams(260, 1, 5);
+	ook.sendKakuOld(radio, 'A', 1, true);									// Clear channel
+	ook.sendKakuOld(radio, 'A', 1, true);
+	radio.rssi = -50;														// Busy channel up to the limit
+	ook.setChannelAccess(0, 5, OOK_CSMA_FORCE);
+	ook.sendKakuOld(radio, 'A', 1, true);
+	ook.setChannelAccess(0, 50, OOK_CSMA_DROP);
+	ook.sendKakuOld(radio, 'A', 1, true);
+	ook.setChannelAccess(0, RF69_CSMA_LIMIT_MS, OOK_CSMA_FORCE);
+	ook.sendKakuOld(radio, 'A', 1, true);
+	const OokStats &stats = ook.getStats();
+	OOK_CHECK(stats.csmaWaits[0] == 2 && stats.csmaWaits[1] == 0);
+	OOK_CHECK(stats.csmaWaits[2] == 1 && stats.csmaWaits[3] == 1 && stats.csmaWaits[4] == 1);
+	OOK_CHECK(stats.csmaTimeouts == 3);
+	OOK_CHECK(stats.protocols[OOK_KAKU_OLD].frames == 4);					// The dropped frame is not counted
+}
+
+// resetStats clears every counter, the next sendings are counted from zero
+OOK_TEST(statsReset)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	ook.setOokParams(260, 2, 5);
+	ook.sendKakuNew(radio, 1332798, 1, true, false, 0);
+	OOK_CHECK(ook.getStats().total.frames == 1);
+	ook.resetStats();
+	static const OokStats zero = {};
+	OOK_CHECK(memcmp(&ook.getStats(), &zero, sizeof(zero)) == 0);
+	ookSimReset();
+	ook.sendKakuCogex(radio, 5, 3, true);
+	const OokStats &stats = ook.getStats();
+	OOK_CHECK(stats.total.frames == 1 && stats.total.repeats == 2);
+	OOK_CHECK(stats.protocols[OOK_KAKU_COGEX].frames == 1 && stats.protocols[OOK_KAKU_NEW].frames == 0);
+	OOK_CHECK(stats.csmaWaits[0] == 1);
+	OOK_CHECK(stats.regReads == ookSimCount(OOK_SIM_REG_READ));
+	OOK_CHECK(stats.regWrites == ookSimCount(OOK_SIM_REG_WRITE));
+}
+#else
+// Compiled out, the telemetry stays all zero
+OOK_TEST(statsCompiledOut)
+{
+	RFM69 radio;
+	RFM69OOK ook;
+	ook.sendKakuNew(radio, 1332798, 1, true, false, 0);
+	static const OokStats zero = {};
+	OOK_CHECK(memcmp(&ook.getStats(), &zero, sizeof(zero)) == 0);
+}
+#endif